@@ -1,5 +1,21 @@
 #pragma once
 
+#include "append_log.h"
+#include "async_generator.h"
+#include "block_cache.h"
+#include "channel.h"
+#include "connection_pool.h"
 #include "context.h"
+#include "copy.h"
+#include "expected.h"
 #include "file.h"
-#include "sync_task.h"
\ No newline at end of file
+#include "framed_reader.h"
+#include "io_scheduler.h"
+#include "listener.h"
+#include "recv_buffer_group.h"
+#include "runtime.h"
+#include "scan_dir.h"
+#include "sim_context.h"
+#include "sync_task.h"
+#include "synchronization.h"
+#include "task_group.h"
\ No newline at end of file
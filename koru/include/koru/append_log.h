@@ -0,0 +1,182 @@
+//
+// APPEND LOG : Durable log committing concurrent appends in groups
+//
+
+#pragma once
+
+#include "context.h"
+#include "sync_task.h"
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <span>
+#include <system_error>
+#include <vector>
+
+namespace koru
+{
+/// @brief The tunables of an append_log.
+struct append_log_options {
+    /// The size in bytes beyond which a group takes no more records. A single bigger record still forms a group of its own.
+    std::size_t max_batch_bytes = std::size_t{1} << 20;
+    /// How long to wait for more records to join a group that's not full yet before committing it.
+    std::chrono::milliseconds max_delay{0};
+    /// Whether to commit with fdatasync() rather than fsync().
+    bool data_only = true;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
+/// @brief Appends records to a file, coalescing the appends that arrive while a commit is ongoing into a single write and flush. Must only be used from the thread running its context.
+/// @tparam Ctx The type of the context operating on the file.
+template <class Ctx>
+class append_log
+{
+    struct waiter {
+        waiter *next;
+        std::coroutine_handle<> h;
+        std::exception_ptr ep;
+        uint64_t offset; // Of the record
+    };
+
+    // Records to be written and flushed together
+    struct group {
+        uint64_t offset;
+        std::vector<std::byte> bytes;
+        waiter *head = nullptr, *tail = nullptr;
+    };
+
+    class append_task : waiter
+    {
+        friend class append_log;
+
+        KORU_inline append_task(append_log &log,
+                                const std::span<const std::byte> rec) noexcept
+            : waiter{}, log_{log}, rec_{rec}
+        {
+        }
+
+      public:
+        KORU_defctor(append_task, = delete;);
+
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            this->h = h;
+            log_.enqueue(*this, rec_);
+        }
+        uint64_t await_resume() const
+        {
+            if (this->ep) [[unlikely]]
+                std::rethrow_exception(this->ep);
+            return this->offset;
+        }
+
+      private:
+        append_log &log_;
+        std::span<const std::byte> rec_;
+    };
+
+  public:
+    /// @brief Creates a log appending to the given file.
+    /// @param ctx The context to submit the writes and flushes to.
+    /// @param f A file opened by ctx with write access; must outlive *this.
+    /// @param end The offset to append the first record at, e.g., the size of the file.
+    /// @param opts The tunables of the group commit.
+    [[nodiscard]] append_log(Ctx &ctx, const detail::file &f,
+                             const uint64_t end            = 0,
+                             const append_log_options opts = {})
+        : ctx_{ctx}, file_{f}, opts_{opts}, end_{end}
+    {
+    }
+    KORU_defctor(append_log, = delete;);
+
+    /// @brief Appends a record, resuming the awaiting coroutine once the record is durable. Fails if writing or flushing the group of the record fails.
+    /// @param rec The bytes of the record; copied before the awaiting coroutine is suspended.
+    /// @return Task object resulting in the offset the record got written at; must be awaited on immediately.
+    [[nodiscard]] KORU_inline append_task
+    append(const std::span<const std::byte> rec) noexcept
+    {
+        return {*this, rec};
+    }
+
+    /// @return The offset the next record will be appended at.
+    [[nodiscard]] uint64_t end() const noexcept { return end_; }
+
+    /// @return Whether a group is being committed or waiting to be.
+    [[nodiscard]] bool busy() const noexcept { return flushing_; }
+
+  private:
+    // The flush may complete inline and resume, hence destroy, w at once
+    void enqueue(waiter &w, const std::span<const std::byte> rec)
+    {
+        // Groups being committed have been popped; the back one is open
+        if (groups_.empty() ||
+            (!groups_.back().bytes.empty() &&
+             groups_.back().bytes.size() + rec.size() > opts_.max_batch_bytes))
+            groups_.push_back({end_});
+        auto &g = groups_.back();
+        g.bytes.insert(g.bytes.end(), rec.begin(), rec.end());
+        w.offset = std::exchange(end_, end_ + rec.size());
+        (g.tail ? g.tail->next : g.head) = &w;
+        g.tail                           = &w;
+
+        if (!flushing_) {
+            flushing_ = true;
+            detail::spawn([this] { return flush(); });
+        }
+    }
+
+    sync_task<void> flush()
+    {
+        while (!groups_.empty()) {
+            if (opts_.max_delay.count() &&
+                groups_.front().bytes.size() < opts_.max_batch_bytes)
+                co_await ctx_.sleep_for(opts_.max_delay);
+            auto g = std::move(groups_.front());
+            groups_.pop_front();
+
+            std::exception_ptr ep;
+            try {
+                co_await commit(g);
+            } catch (...) {
+                ep = std::current_exception();
+            }
+            for (auto w = g.head; w;) {
+                // The resumed coroutine may destroy the waiter
+                const auto next = w->next;
+                w->ep           = ep;
+                w->h.resume();
+                w = next;
+            }
+        }
+        flushing_ = false;
+    }
+
+    sync_task<void> commit(const group &g)
+    {
+        for (std::size_t off = 0; off < g.bytes.size();) {
+            const auto n = static_cast<uint32_t>(
+                std::min<std::size_t>(g.bytes.size() - off, UINT32_MAX));
+            const auto written =
+                co_await ctx_.write(file_.at(g.offset + off), &g.bytes[off], n);
+            if (!written) [[unlikely]]
+                throw std::system_error{std::make_error_code(
+                    std::errc::no_space_on_device)};
+            off += written;
+        }
+        if (opts_.data_only)
+            co_await ctx_.fdatasync(file_);
+        else
+            co_await ctx_.fsync(file_);
+    }
+
+    Ctx &ctx_;
+    const detail::file &file_;
+    append_log_options opts_;
+    uint64_t end_;
+    std::deque<group> groups_;
+    bool flushing_ = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+} // namespace koru
\ No newline at end of file
@@ -0,0 +1,141 @@
+//
+// ASYNC GENERATOR : Lazily started coroutine yielding values one at a time
+//
+
+#pragma once
+
+#include "detail/utils.h"
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+namespace koru
+{
+namespace detail
+{
+/// @brief Models a coroutine that may await between yielding values to its consumer, which resumes it for each value in turn. Values are yielded by reference, so none gets copied or allocated on its way to the consumer. The coroutine starts once the first value is asked for; destroying the generator destroys the coroutine, abandoning it at its last yield.
+/// @tparam T The type of the yielded values; may be const-qualified.
+template <class T>
+class async_generator
+{
+  public:
+    class promise_type;
+
+  private:
+    using handle = std::coroutine_handle<promise_type>;
+
+    // Suspends the generator, transferring control back to its consumer
+    struct yield_awaiter {
+        constexpr bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(const handle h) const noexcept
+        {
+            return h.promise().consumer_;
+        }
+        constexpr void await_resume() const noexcept {}
+    };
+
+    class next_task
+    {
+        friend class async_generator;
+
+        KORU_inline next_task(const handle h) noexcept : h_{h} {}
+
+      public:
+        KORU_defctor(next_task, = delete;);
+
+        bool await_ready() const noexcept { return h_.done(); }
+        std::coroutine_handle<>
+        await_suspend(const std::coroutine_handle<> h) const noexcept
+        {
+            h_.promise().consumer_ = h;
+            return h_;
+        }
+        T *await_resume() const
+        {
+            auto &p = h_.promise();
+            if (p.ep_) [[unlikely]]
+                std::rethrow_exception(std::exchange(p.ep_, nullptr));
+            return p.value_;
+        }
+
+      private:
+        handle h_;
+    };
+
+  public:
+    class promise_type
+    {
+        friend class async_generator;
+
+      public:
+        async_generator get_return_object() noexcept
+        {
+            return async_generator{handle::from_promise(*this)};
+        }
+        constexpr std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+        constexpr yield_awaiter final_suspend() const noexcept { return {}; }
+
+        // A yielded temporary lives until the generator gets resumed
+        yield_awaiter yield_value(T &x) noexcept
+        {
+            value_ = std::addressof(x);
+            return {};
+        }
+        yield_awaiter yield_value(T &&x) noexcept
+        {
+            value_ = std::addressof(x);
+            return {};
+        }
+
+        constexpr void return_void() noexcept { value_ = nullptr; }
+        void unhandled_exception() noexcept
+        {
+            ep_    = std::current_exception();
+            value_ = nullptr;
+        }
+
+      private:
+        T *value_ = nullptr;
+        std::coroutine_handle<> consumer_;
+        std::exception_ptr ep_;
+    };
+
+    async_generator(async_generator &&other) noexcept
+        : h_{std::exchange(other.h_, {})}
+    {
+    }
+    async_generator &operator=(async_generator &&other) noexcept
+    {
+        if (this != &other) {
+            if (h_)
+                h_.destroy();
+            h_ = std::exchange(other.h_, {});
+        }
+        return *this;
+    }
+    ~async_generator()
+    {
+        if (h_)
+            h_.destroy();
+    }
+
+    /// @brief Resumes the generator until it yields its next value or returns. An exception escaping the generator gets rethrown, ending the sequence.
+    /// @return Task object resulting in a pointer to the value, valid until the next call, or nullptr once the generator has returned; must be awaited on immediately.
+    [[nodiscard]] KORU_inline next_task next() noexcept
+    {
+        KORU_assert(h_);
+        return {h_};
+    }
+
+  private:
+    [[nodiscard]] explicit async_generator(const handle h) noexcept : h_{h} {}
+
+    handle h_;
+};
+} // namespace detail
+using detail::async_generator;
+} // namespace koru
\ No newline at end of file
@@ -0,0 +1,397 @@
+//
+// BLOCK CACHE : Sharded cache of file blocks in front of a context's reads
+//
+
+#pragma once
+
+#include "context.h"
+#include "detail/waiters.h"
+#include "sync_task.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace koru
+{
+/// @brief The tunables of a block_cache.
+struct block_cache_options {
+    /// The memory budget in bytes for the cached blocks, split evenly among the shards.
+    std::size_t capacity = std::size_t{64} << 20;
+    /// The size in bytes of a block; has to be a power of two.
+    uint32_t block_size = 4096;
+    /// The number of independently locked and evicted parts of the cache.
+    uint32_t shards = 1;
+};
+
+/// @brief Counters describing the effectiveness of a block_cache.
+struct block_cache_stats {
+    /// The number of block lookups that found the block cached.
+    std::size_t hits;
+    /// The number of block lookups that started a read of the block.
+    std::size_t misses;
+    /// The number of block lookups that joined a read of the block started by another.
+    std::size_t shared;
+    /// The number of block lookups that read around the cache as no block could be evicted.
+    std::size_t bypassed;
+    /// The number of blocks evicted to make room for others.
+    std::size_t evictions;
+};
+
+/// @brief Caches blocks of files read through a context, evicting them in CLOCK order. Reads of cached blocks complete without suspending; concurrent reads of a missing block share a single read. Writes aren't seen by the cache; see invalidate().
+/// @tparam Ctx The type of the context to read through.
+/// @tparam Atomic Whether reads may be issued from several threads at once, as allowed by AtomicIos contexts.
+template <class Ctx, bool Atomic = false>
+class block_cache
+{
+    struct key {
+        detail::HANDLE h;
+        uint64_t block;
+        bool operator==(const key &) const noexcept = default;
+    };
+    struct key_hash {
+        std::size_t operator()(const key &k) const noexcept
+        {
+            return std::hash<uint64_t>{}(
+                std::bit_cast<uintptr_t>(k.h) * 0x9E3779B97F4A7C15 ^ k.block);
+        }
+    };
+
+    // A coroutine awaiting the read of a block started by another
+    struct waiter {
+        waiter *next;
+        std::coroutine_handle<> h;
+        std::exception_ptr ep;
+    };
+
+    enum class state : unsigned char { empty, loading, ready };
+
+    struct frame {
+        key k;
+        waiter *waiters;
+        uint32_t len;
+        uint32_t pins;
+        state st;
+        bool ref;
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+    struct shard
+        : std::conditional_t<Atomic, detail::lockable, detail::empty> {
+        std::unordered_map<key, uint32_t, key_hash> index;
+        std::vector<frame> frames;
+        std::unique_ptr<std::byte[]> data;
+        uint32_t hand = 0;
+        block_cache_stats stats{};
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+    class read_task
+    {
+        friend class block_cache;
+
+        KORU_inline read_task(block_cache &c, const detail::file::location l,
+                              void *const buf, const uint32_t nbytes) noexcept
+            : c_{c}, l_{l}, buf_{static_cast<std::byte *>(buf)}, n_{nbytes}
+        {
+        }
+
+      public:
+        KORU_defctor(read_task, = delete;);
+
+        bool await_ready() noexcept { return c_.try_hit(*this); }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            h_ = h;
+            detail::spawn([this] { return c_.fill(*this); });
+        }
+        std::size_t await_resume() const
+        {
+            if (ep_) [[unlikely]]
+                std::rethrow_exception(ep_);
+            return done_;
+        }
+
+      private:
+        uint64_t pos() const noexcept { return l_.offset + done_; }
+
+        block_cache &c_;
+        detail::file::location l_;
+        std::byte *buf_;
+        uint32_t n_, done_ = 0;
+        std::coroutine_handle<> h_;
+        std::exception_ptr ep_;
+    };
+
+    // Links a waiter onto a loading frame, releasing the shard lock only then
+    template <class Lock>
+    struct join_task {
+        frame &f;
+        waiter &w;
+        Lock &l;
+
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            w.h       = h;
+            w.next    = f.waiters;
+            f.waiters = &w;
+            if constexpr (Atomic)
+                l.unlock();
+        }
+        constexpr void await_resume() const noexcept {}
+    };
+
+  public:
+    /// @param ctx The context to read through.
+    /// @param opts The tunables of the cache.
+    [[nodiscard]] explicit block_cache(Ctx &ctx,
+                                       const block_cache_options opts = {})
+        : ctx_{ctx}, bs_{opts.block_size},
+          nshards_{std::max<uint32_t>(opts.shards, 1)},
+          shards_{std::make_unique<shard[]>(nshards_)}
+    {
+        KORU_assert(std::has_single_bit(bs_));
+        const auto nframes =
+            std::max<std::size_t>(opts.capacity / bs_ / nshards_, 1);
+        for (uint32_t i = 0; i < nshards_; ++i) {
+            auto &s = shards_[i];
+            s.frames.resize(nframes);
+            s.index.reserve(nframes);
+            s.data =
+                std::make_unique_for_overwrite<std::byte[]>(nframes * bs_);
+        }
+    }
+    KORU_defctor(block_cache, = delete;);
+
+    /// @brief Like Ctx::read(), but serves the bytes from the cache where possible, caching the blocks read otherwise.
+    /// @param l A location on a file opened by the context with read access.
+    /// @param buf A pointer denoting the recipient buffer.
+    /// @param nbytes The maximum number of bytes to read.
+    /// @return Task object resulting in the number of bytes read; must be awaited on immediately.
+    [[nodiscard]] KORU_inline read_task read(const detail::file::location l,
+                                             void *const buf,
+                                             const uint32_t nbytes) noexcept
+    {
+        return {*this, l, buf, nbytes};
+    }
+
+    /// @brief Drops the cached blocks of a file, e.g., after writing to it or before closing it. Blocks being read meanwhile are kept.
+    /// @param f A file read through *this.
+    void invalidate(const detail::file &f) noexcept
+    {
+        for (uint32_t i = 0; i < nshards_; ++i) {
+            auto &s      = shards_[i];
+            const auto l = lock(s);
+            for (auto &fr : s.frames) {
+                if (fr.st == state::ready && fr.k.h == f.native_handle &&
+                    !fr.pins) {
+                    s.index.erase(fr.k);
+                    fr.st = state::empty;
+                }
+            }
+        }
+    }
+
+    /// @return Counters describing the effectiveness of *this, summed over the shards.
+    [[nodiscard]] block_cache_stats stats() noexcept
+    {
+        block_cache_stats res{};
+        for (uint32_t i = 0; i < nshards_; ++i) {
+            auto &s      = shards_[i];
+            const auto l = lock(s);
+            res.hits += s.stats.hits;
+            res.misses += s.stats.misses;
+            res.shared += s.stats.shared;
+            res.bypassed += s.stats.bypassed;
+            res.evictions += s.stats.evictions;
+        }
+        return res;
+    }
+
+  private:
+    static KORU_inline auto lock([[maybe_unused]] shard &s) noexcept
+    {
+        if constexpr (Atomic)
+            return detail::lock<false>{s.srwl};
+        else
+            return detail::empty{};
+    }
+
+    static KORU_inline void unlock([[maybe_unused]] auto &l) noexcept
+    {
+        if constexpr (Atomic)
+            l.unlock();
+    }
+
+    shard &shard_of(const key &k) noexcept
+    {
+        return shards_[key_hash{}(k) % nshards_];
+    }
+
+    std::byte *data_of(shard &s, const frame &f) noexcept
+    {
+        const auto i = static_cast<std::size_t>(&f - s.frames.data());
+        return s.data.get() + i * bs_;
+    }
+
+    /// @brief Copies the part of a cached block the read wants. A short block marks the end of the file, ending the read.
+    void copy_out(read_task &t, const std::byte *const block,
+                  const uint32_t len) noexcept
+    {
+        const auto skip = static_cast<uint32_t>(t.pos() & (bs_ - 1));
+        const auto n    = len > skip ? std::min(len - skip, t.n_ - t.done_) : 0;
+        std::memcpy(t.buf_ + t.done_, block + skip, n);
+        t.done_ += n;
+        if (len < bs_)
+            t.n_ = t.done_;
+    }
+
+    /// @brief Serves as much of the read as possible from cached blocks.
+    /// @return Whether the read got served in full.
+    bool try_hit(read_task &t) noexcept
+    {
+        while (t.done_ < t.n_) {
+            const key k{t.l_.handle, t.pos() / bs_};
+            auto &s       = shard_of(k);
+            const auto l  = lock(s);
+            const auto it = s.index.find(k);
+            if (it == s.index.end() ||
+                s.frames[it->second].st != state::ready)
+                return false;
+            auto &f = s.frames[it->second];
+            f.ref   = true;
+            ++s.stats.hits;
+            copy_out(t, data_of(s, f), f.len);
+        }
+        return true;
+    }
+
+    /// @brief Serves the rest of a read that missed the cache, then resumes its awaiter.
+    sync_task<void> fill(read_task &t)
+    {
+        try {
+            while (t.done_ < t.n_) {
+                const key k{t.l_.handle, t.pos() / bs_};
+                auto &s = shard_of(k);
+                if (const auto f = co_await acquire(s, k, t.l_.priority)) {
+                    copy_out(t, data_of(s, *f), f->len);
+                    const auto l = lock(s);
+                    --f->pins;
+                } else {
+                    // Every frame is busy; read the rest around the cache
+                    t.done_ += static_cast<uint32_t>(co_await ctx_.read(
+                        {t.pos(), t.l_.handle, t.l_.priority}, t.buf_ + t.done_,
+                        t.n_ - t.done_));
+                    t.n_ = t.done_;
+                }
+            }
+        } catch (...) {
+            t.ep_ = std::current_exception();
+        }
+        t.h_.resume();
+    }
+
+    /// @brief Finds or reads in a block, pinning its frame.
+    /// @param prio The class of the read of the block, if it has to be read.
+    /// @return The pinned frame, or nullptr if there's no frame to read the block into.
+    sync_task<frame *> acquire(shard &s, const key k, const io_priority prio)
+    {
+        auto l = lock(s);
+        if (const auto it = s.index.find(k); it != s.index.end()) {
+            auto &f = s.frames[it->second];
+            if (f.st == state::ready) {
+                ++f.pins;
+                f.ref = true;
+                ++s.stats.hits;
+                co_return &f;
+            }
+            // Share the read that's already in flight; it pins f for us
+            ++s.stats.shared;
+            waiter w{};
+            co_await join_task<decltype(l)>{f, w, l};
+            if (w.ep)
+                std::rethrow_exception(w.ep);
+            co_return &f;
+        }
+
+        ++s.stats.misses;
+        const auto f = evict(s);
+        if (!f) {
+            ++s.stats.bypassed;
+            co_return nullptr;
+        }
+        s.index.emplace(k, static_cast<uint32_t>(f - s.frames.data()));
+        *f = {.k = k, .waiters = nullptr, .len = 0, .pins = 1,
+              .st = state::loading, .ref = true};
+        unlock(l);
+
+        std::exception_ptr ep;
+        std::size_t len = 0;
+        try {
+            len = co_await ctx_.read({k.block * bs_, k.h, prio}, data_of(s, *f),
+                                     bs_);
+        } catch (...) {
+            ep = std::current_exception();
+        }
+        waiter *ws;
+        {
+            const auto l2 = lock(s);
+            ws            = std::exchange(f->waiters, nullptr);
+            if (ep) {
+                s.index.erase(k);
+                f->st   = state::empty;
+                f->pins = 0;
+            } else {
+                f->st  = state::ready;
+                f->len = static_cast<uint32_t>(len);
+                for (auto w = ws; w; w = w->next)
+                    ++f->pins;
+            }
+        }
+        for (auto w = ws; w;) {
+            // The resumed coroutine may destroy the waiter
+            const auto next = w->next;
+            w->ep           = ep;
+            w->h.resume();
+            w = next;
+        }
+        if (ep)
+            std::rethrow_exception(ep);
+        co_return f;
+    }
+
+    /// @brief Sweeps the clock hand over the frames of a shard, giving referenced ones a second chance.
+    /// @return An empty frame, or nullptr if every frame is pinned or loading.
+    frame *evict(shard &s) noexcept
+    {
+        const auto n = s.frames.size();
+        for (std::size_t i = 0; i < 2 * n; ++i) {
+            auto &f = s.frames[s.hand];
+            s.hand  = static_cast<uint32_t>((s.hand + 1) % n);
+            if (f.st == state::empty)
+                return &f;
+            if (f.st == state::loading || f.pins)
+                continue;
+            if (f.ref) {
+                f.ref = false;
+                continue;
+            }
+            s.index.erase(f.k);
+            f.st = state::empty;
+            ++s.stats.evictions;
+            return &f;
+        }
+        return nullptr;
+    }
+
+    Ctx &ctx_;
+    uint32_t bs_, nshards_;
+    std::unique_ptr<shard[]> shards_;
+};
+} // namespace koru
\ No newline at end of file
@@ -0,0 +1,289 @@
+//
+// CHANNEL : Bounded queue passing values between coroutines
+//
+
+#pragma once
+
+#include "detail/waiters.h"
+#include <array>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace koru
+{
+/// @brief A bounded FIFO queue passing values from sending to receiving coroutines. Sending suspends while the queue is full and receiving while it's empty, so no pipeline stage can run more than N values ahead of the next. A suspended coroutine gets resumed by the context it awaited through.
+/// @tparam T The type of the values passed.
+/// @tparam N The number of values buffered before senders suspend.
+/// @tparam Atomic Whether coroutines running on several threads may use the channel at once, each awaiting through a context of its own. Such contexts need AtomicIos set, as well as AsyncIos to notice resumptions while waiting for I/O.
+template <class T, std::size_t N, bool Atomic = false>
+class channel : std::conditional_t<Atomic, detail::lockable, detail::empty>
+{
+    static_assert(N > 0, "a channel must have room for a value");
+
+    struct sender : detail::waiter {
+        template <class Ctx>
+        sender(Ctx &ctx, T &&x) noexcept(
+            std::is_nothrow_move_constructible_v<T>)
+            : detail::waiter{ctx}, x{static_cast<T &&>(x)}
+        {
+        }
+
+        T x;
+        bool ok = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+    struct receiver : detail::waiter {
+        using detail::waiter::waiter;
+
+        std::optional<T> x;
+    };
+
+    template <class Ctx>
+    class send_task : sender
+    {
+        friend class channel;
+
+        KORU_inline send_task(channel &ch, Ctx &ctx, T &&x) noexcept(
+            std::is_nothrow_move_constructible_v<T>)
+            : sender{ctx, static_cast<T &&>(x)}, ch_{ch}
+        {
+        }
+
+      public:
+        KORU_defctor(send_task, = delete;);
+
+        bool await_ready()
+        {
+            if constexpr (Atomic)
+                return false;
+            else
+                return ch_.try_send(*this);
+        }
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            this->h = h;
+            return ch_.send_or_wait(*this);
+        }
+        bool await_resume() const noexcept { return this->ok; }
+
+      private:
+        channel &ch_;
+    };
+
+    template <class Ctx>
+    class recv_task : receiver
+    {
+        friend class channel;
+
+        KORU_inline recv_task(channel &ch, Ctx &ctx) noexcept
+            : receiver{ctx}, ch_{ch}
+        {
+        }
+
+      public:
+        KORU_defctor(recv_task, = delete;);
+
+        bool await_ready()
+        {
+            if constexpr (Atomic)
+                return false;
+            else
+                return ch_.try_recv(*this);
+        }
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            this->h = h;
+            return ch_.recv_or_wait(*this);
+        }
+        std::optional<T> await_resume() noexcept(
+            std::is_nothrow_move_constructible_v<T>)
+        {
+            return static_cast<std::optional<T> &&>(this->x);
+        }
+
+      private:
+        channel &ch_;
+    };
+
+  public:
+    KORU_defctor(channel, = default;);
+    ~channel()
+    {
+        for (std::size_t i = 0; i < size_; ++i)
+            slot(i)->~T();
+    }
+
+    /// @brief Queues a value, suspending while the channel is full.
+    /// @param ctx The context to resume the awaiting coroutine through if it has to suspend.
+    /// @param x The value to pass.
+    /// @return Task object resulting in whether the value got queued, which it doesn't once the channel has been closed; must be awaited on immediately.
+    template <class Ctx>
+    [[nodiscard]] KORU_inline send_task<Ctx> send(Ctx &ctx, T x) noexcept(
+        std::is_nothrow_move_constructible_v<T>)
+    {
+        return {*this, ctx, static_cast<T &&>(x)};
+    }
+
+    /// @brief Dequeues the oldest value, suspending while the channel is empty.
+    /// @param ctx The context to resume the awaiting coroutine through if it has to suspend.
+    /// @return Task object resulting in the value, or std::nullopt once the channel has been closed and drained; must be awaited on immediately.
+    template <class Ctx>
+    [[nodiscard]] KORU_inline recv_task<Ctx> recv(Ctx &ctx) noexcept
+    {
+        return {*this, ctx};
+    }
+
+    /// @brief Closes the channel: suspended senders fail, while receivers get the values still queued, then std::nullopt.
+    void close() noexcept
+    {
+        detail::waiter *s, *r;
+        {
+            const auto l = lock();
+            closed_      = true;
+            s            = senders_.take_all();
+            r            = receivers_.take_all();
+        }
+        detail::wake_all(s);
+        detail::wake_all(r);
+    }
+
+    /// @return The number of values queued.
+    [[nodiscard]] std::size_t size() noexcept
+    {
+        const auto l = lock();
+        return size_;
+    }
+
+  private:
+    KORU_inline auto lock() noexcept
+    {
+        if constexpr (Atomic)
+            return detail::lock<false>{this->srwl};
+        else
+            return detail::empty{};
+    }
+
+    T *slot(const std::size_t i) noexcept
+    {
+        return std::launder(reinterpret_cast<T *>(&ring_[(head_ + i) % N]));
+    }
+
+    void push(T &&x)
+    {
+        new (slot(size_)) T{static_cast<T &&>(x)};
+        ++size_;
+    }
+
+    T pop()
+    {
+        const auto p = slot(0);
+        T x{static_cast<T &&>(*p)};
+        p->~T();
+        head_ = (head_ + 1) % N;
+        --size_;
+        return x;
+    }
+
+    /// @brief Completes a send without suspending if possible. Must be called with the lock held.
+    /// @param wake Set to the receiver to wake, if any.
+    /// @return Whether the send completed.
+    bool try_send(sender &s, detail::waiter *&wake)
+    {
+        if (closed_) {
+            s.ok = false;
+            return true;
+        }
+        // Receivers only wait on an empty queue, so take the value directly
+        if (const auto w = receivers_.pop()) {
+            static_cast<receiver *>(w)->x.emplace(static_cast<T &&>(s.x));
+            wake = w;
+        } else if (size_ < N) {
+            push(static_cast<T &&>(s.x));
+        } else {
+            return false;
+        }
+        s.ok = true;
+        return true;
+    }
+
+    /// @brief Completes a receive without suspending if possible. Must be called with the lock held.
+    /// @param wake Set to the sender to wake, if any.
+    /// @return Whether the receive completed.
+    bool try_recv(receiver &r, detail::waiter *&wake)
+    {
+        if (!size_)
+            return closed_;
+        r.x.emplace(pop());
+        // Senders only wait on a full queue, so take the value of the first
+        if (const auto w = senders_.pop()) {
+            const auto s = static_cast<sender *>(w);
+            push(static_cast<T &&>(s->x));
+            s->ok = true;
+            wake  = w;
+        }
+        return true;
+    }
+
+    bool try_send(sender &s)
+    {
+        detail::waiter *wake = nullptr;
+        if (!try_send(s, wake))
+            return false;
+        if (wake)
+            wake->wake();
+        return true;
+    }
+
+    bool try_recv(receiver &r)
+    {
+        detail::waiter *wake = nullptr;
+        if (!try_recv(r, wake))
+            return false;
+        if (wake)
+            wake->wake();
+        return true;
+    }
+
+    /// @return Whether the sender got queued to wait.
+    bool send_or_wait(sender &s)
+    {
+        detail::waiter *wake = nullptr;
+        {
+            const auto l = lock();
+            if (!Atomic || !try_send(s, wake)) {
+                senders_.push(s);
+                return true;
+            }
+        }
+        if (wake)
+            wake->wake();
+        return false;
+    }
+
+    /// @return Whether the receiver got queued to wait.
+    bool recv_or_wait(receiver &r)
+    {
+        detail::waiter *wake = nullptr;
+        {
+            const auto l = lock();
+            if (!Atomic || !try_recv(r, wake)) {
+                receivers_.push(r);
+                return true;
+            }
+        }
+        if (wake)
+            wake->wake();
+        return false;
+    }
+
+    std::array<std::aligned_storage_t<sizeof(T), alignof(T)>, N> ring_;
+    std::size_t head_ = 0, size_ = 0;
+    detail::waiter_queue senders_, receivers_;
+    bool closed_ = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+} // namespace koru
\ No newline at end of file
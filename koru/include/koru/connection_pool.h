@@ -0,0 +1,305 @@
+//
+// CONNECTION POOL : Outbound connections kept open for reuse
+//
+
+#pragma once
+
+#include "context.h"
+#include "detail/waiters.h"
+#include "sync_task.h"
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <utility>
+
+namespace koru
+{
+namespace detail
+{
+/// @return Whether an idle connection is still usable, i.e., the peer hasn't closed or reset it; doesn't wait.
+bool is_alive(SOCKET s) noexcept;
+} // namespace detail
+
+/// @brief The tunables of a connection_pool.
+struct connection_pool_options {
+    /// The greatest number of connections open at once, leased or idle; acquiring suspends while that many are leased.
+    std::size_t max_connections = 64;
+    /// The greatest number of idle connections kept open for reuse; the ones released beyond it get closed.
+    std::size_t max_idle = 16;
+    /// How long a connection stays idle before getting closed.
+    std::chrono::milliseconds idle_timeout{30000};
+};
+
+/// @brief Keeps the stream connections to an endpoint open in between uses, so that repeated requests skip the handshake. Idle connections get reused most recently released first, each checked for having been closed by the peer before being handed out, and closed once idle for longer than a timeout, which a timer of the context enforces; while any is idle, that timer keeps run() from returning. Must only be used from the thread running its context.
+/// @tparam Ctx The type of the context the connections get operated on by.
+template <class Ctx>
+class connection_pool
+{
+    using clock      = std::chrono::steady_clock;
+    using socket_ptr = std::unique_ptr<detail::socket>;
+    using sleep_task =
+        decltype(std::declval<Ctx &>().sleep_until(clock::time_point{}));
+
+    struct idle_conn {
+        socket_ptr s;
+        clock::time_point since;
+    };
+
+    // An acquirer waiting for a connection to be released
+    struct acquirer : detail::waiter {
+        using detail::waiter::waiter;
+
+        socket_ptr s; // The connection handed over, if not just its slot
+    };
+
+    // Shared with the leases and the reaper, which may outlive the pool
+    struct state {
+        state(Ctx &c, const detail::endpoint &e,
+              const connection_pool_options o) noexcept
+            : ctx{c}, ep{e}, opts{o}
+        {
+        }
+
+        Ctx &ctx;
+        detail::endpoint ep;
+        connection_pool_options opts;
+        std::deque<idle_conn> idle; // Least recently released first
+        detail::waiter_queue acquirers;
+        sleep_task *reaper_sleep = nullptr; // While the reaper waits
+        std::size_t open = 0;
+        bool reaping = false, closed = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+    class wait_task : acquirer
+    {
+        friend class connection_pool;
+
+        KORU_inline wait_task(state &st) noexcept : acquirer{st.ctx}, st_{st}
+        {
+        }
+
+      public:
+        KORU_defctor(wait_task, = delete;);
+
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            this->h = h;
+            st_.acquirers.push(*this);
+        }
+        socket_ptr await_resume() noexcept { return std::move(this->s); }
+
+      private:
+        state &st_;
+    };
+
+    // Connects a socket and moves it to the heap, where leases can own it
+    class connect_task
+    {
+        friend class connection_pool;
+
+        KORU_inline connect_task(state &st) : conn_{st.ctx.connect(st.ep)} {}
+
+      public:
+        KORU_defctor(connect_task, = delete;);
+
+        bool await_ready() const noexcept { return conn_.await_ready(); }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            conn_.await_suspend(h);
+        }
+        socket_ptr await_resume()
+        {
+            return socket_ptr{new detail::socket(conn_.await_resume())};
+        }
+
+      private:
+        decltype(std::declval<Ctx &>().connect(
+            std::declval<const detail::endpoint &>())) conn_;
+    };
+
+  public:
+    /// @brief Owns a connection of a pool, returning it to the pool on destruction.
+    class lease
+    {
+        friend class connection_pool;
+
+        lease(std::shared_ptr<state> st, socket_ptr s) noexcept
+            : st_{std::move(st)}, s_{std::move(s)}
+        {
+        }
+
+      public:
+        lease(lease &&) noexcept  = default;
+        lease &operator=(lease &&) = delete;
+        ~lease()
+        {
+            if (s_)
+                release(st_, std::move(s_), discarded_);
+        }
+
+        /// @return The connected socket.
+        [[nodiscard]] const detail::socket &socket() const noexcept
+        {
+            KORU_assert(s_);
+            return *s_;
+        }
+
+        /// @brief Keeps the connection from getting reused, e.g., because an operation on it failed or left it mid-message, so that it gets closed once *this gets destroyed.
+        void discard() noexcept { discarded_ = true; }
+
+      private:
+        std::shared_ptr<state> st_;
+        socket_ptr s_;
+        bool discarded_ = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+  private:
+    class acquire_task
+    {
+        friend class connection_pool;
+
+        KORU_inline acquire_task(connection_pool &p) : t_{p.lease_one()} {}
+
+      public:
+        KORU_defctor(acquire_task, = delete;);
+
+        bool await_ready() noexcept { return t_.await_ready(); }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            t_.await_suspend(h);
+        }
+        lease await_resume() { return std::move(t_.await_resume()); }
+
+      private:
+        sync_task<lease> t_;
+    };
+
+  public:
+    /// @param ctx The context the connections get operated on by.
+    /// @param ep The address to connect to, as returned by context::resolve().
+    /// @param opts The tunables of *this.
+    [[nodiscard]] connection_pool(Ctx &ctx, const detail::endpoint &ep,
+                                  const connection_pool_options opts = {})
+        : st_{std::make_shared<state>(ctx, ep, opts)}
+    {
+        KORU_assert(opts.max_connections);
+    }
+    KORU_defctor(connection_pool, = delete;);
+    ~connection_pool()
+    {
+        KORU_assert(st_->acquirers.empty());
+        // Leases outliving the pool close their connections once released
+        st_->closed = true;
+        clear();
+    }
+
+    /// @brief Leases a connection, reusing the most recently released idle one that's still alive, or else connecting anew; suspends while max_connections are leased.
+    /// @return Task object resulting in the lease; throws if connecting fails. Must be awaited on immediately.
+    [[nodiscard]] KORU_inline acquire_task acquire() { return {*this}; }
+
+    /// @brief Closes the idle connections.
+    void clear() noexcept
+    {
+        st_->open -= st_->idle.size();
+        st_->idle.clear();
+        wake_reaper(*st_);
+    }
+
+    /// @return The number of connections open, leased or idle.
+    [[nodiscard]] std::size_t open() const noexcept { return st_->open; }
+
+    /// @return The number of idle connections.
+    [[nodiscard]] std::size_t idle() const noexcept { return st_->idle.size(); }
+
+  private:
+    sync_task<lease> lease_one()
+    {
+        auto &st = *st_;
+        while (!st.idle.empty()) {
+            auto s = std::move(st.idle.back().s);
+            st.idle.pop_back();
+            if (st.idle.empty())
+                wake_reaper(st);
+            // The peer may have closed the connection while it was idle
+            if (detail::is_alive(s->native_handle))
+                co_return lease{st_, std::move(s)};
+            --st.open;
+        }
+
+        if (st.open == st.opts.max_connections) {
+            if (auto s = co_await wait_task{st})
+                co_return lease{st_, std::move(s)};
+            // A connection got closed, handing its slot over
+        } else {
+            ++st.open;
+        }
+        try {
+            co_return lease{st_, co_await connect_task{st}};
+        } catch (...) {
+            free_slot(st);
+            throw;
+        }
+    }
+
+    /// @brief Returns a connection, handing it to the longest waiting acquirer or keeping it idle if it's fit for reuse, and otherwise closing it.
+    static void release(const std::shared_ptr<state> &st, socket_ptr s,
+                        const bool discarded) noexcept
+    {
+        if (!discarded && !st->closed) {
+            if (const auto w = st->acquirers.pop()) {
+                static_cast<acquirer *>(w)->s = std::move(s);
+                w->wake();
+                return;
+            }
+            if (st->idle.size() < st->opts.max_idle) {
+                st->idle.push_back({std::move(s), clock::now()});
+                if (!std::exchange(st->reaping, true))
+                    detail::spawn([st] { return reap(st); });
+                return;
+            }
+        }
+        s.reset();
+        free_slot(*st);
+    }
+
+    /// @brief Frees the slot of a closed connection, handing it to the longest waiting acquirer to connect anew.
+    static void free_slot(state &st) noexcept
+    {
+        if (const auto w = st.acquirers.pop())
+            w->wake();
+        else
+            --st.open;
+    }
+
+    /// @brief Lets the reaper return as soon as no connection is idle anymore, rather than once the oldest one would have timed out.
+    static void wake_reaper(state &st) noexcept
+    {
+        if (const auto sleep = std::exchange(st.reaper_sleep, nullptr))
+            sleep->wake();
+    }
+
+    /// @brief Closes idle connections as they time out, until none is left.
+    static sync_task<void> reap(const std::shared_ptr<state> st)
+    {
+        while (!st->idle.empty()) {
+            if (const auto due = st->idle.front().since + st->opts.idle_timeout;
+                clock::now() < due) {
+                auto sleep       = st->ctx.sleep_until(due);
+                st->reaper_sleep = &sleep;
+                co_await sleep;
+                st->reaper_sleep = nullptr;
+                continue;
+            }
+            st->idle.pop_front();
+            --st->open;
+        }
+        st->reaping = false;
+    }
+
+    std::shared_ptr<state> st_;
+};
+} // namespace koru
\ No newline at end of file
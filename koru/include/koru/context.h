@@ -6,12 +6,24 @@
 
 #include "detail/utils.h"
 #include "detail/winapi.h"
+#include "expected.h"
 #include "file.h"
+#include "offload.h"
 #include "socket.h"
+#include "sync_task.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <coroutine>
 #include <exception>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
 #include "detail/win_macros_begin.inl"
 
@@ -20,10 +32,148 @@ namespace koru
 namespace detail
 {
 SOCKET create_socket(const wchar_t *node, const wchar_t *service,
-                     const ADDRINFOW &hints);
+                     const ADDRINFOW &hints, socket_role role);
+/// @brief Receives or sends datagrams one per buffer until the socket would block, without waiting.
+/// @param err Set to the error that stopped the transfer, if other than the socket blocking.
+/// @return The number of datagrams transferred.
+std::size_t transfer_available(SOCKET s, msg_buf *msgs, std::size_t n,
+                               bool send, int &err) noexcept;
+/// @brief Creates a socket to accept a connection on the given listening socket into.
+SOCKET create_accept_socket(SOCKET listener);
+/// @brief Makes an accepted socket inherit the properties of its listening socket.
+void finish_accept(SOCKET listener, SOCKET s);
+endpoint resolve(const wchar_t *node, const wchar_t *service,
+                 const ADDRINFOW &hints);
+/// @brief Creates a socket bound to a wildcard address, as ConnectEx requires, to connect to the given endpoint with.
+SOCKET create_connect_socket(const endpoint &ep);
+/// @brief Makes a socket connected by ConnectEx usable with the rest of the socket functions.
+void finish_connect(SOCKET s);
+file_stat get_file_stat(HANDLE h);
+/// @brief Retrieves the error an overlapped operation completed with once its event got signaled.
+DWORD overlapped_error(HANDLE h, OVERLAPPED &ol) noexcept;
+/// @brief Like overlapped_error(), but for operations on sockets.
+int overlapped_wsa_error(SOCKET s, OVERLAPPED &ol) noexcept;
+void flush(HANDLE h, bool data_only);
+void allocate(HANDLE h, uint64_t offset, uint64_t nbytes);
+/// @brief Sets the priority the storage stack gives the I/Os on a file.
+/// @return Whether the file system supports I/O priority hints.
+bool set_io_priority_hint(HANDLE h, io_priority p) noexcept;
+/// @brief Starts a one-shot timer that signals the given event once due.
+/// @return The timer; to be passed to stop_timer() once it's of no more use.
+HANDLE start_timer(HANDLE ev, DWORD ms);
+/// @brief Cancels a timer, waiting for it to finish signaling if it's already due.
+void stop_timer(HANDLE timer) noexcept;
+
+/// @brief A link in the queue of coroutines ready to be resumed by a context. Lives in the frame of the suspended coroutine.
+struct ready_node {
+    ready_node *next;
+    std::coroutine_handle<> h;
+};
+
+/// @brief Wraps the awaitable of a step of context::chain(), turning its result into a value, detail::empty standing for none.
+template <class A>
+struct chain_step {
+    A a;
+
+    bool await_ready() { return a.await_ready(); }
+    auto await_suspend(const std::coroutine_handle<> h)
+    {
+        return a.await_suspend(h);
+    }
+    auto await_resume()
+    {
+        using R = decltype(a.await_resume());
+        if constexpr (std::is_void_v<R>) {
+            a.await_resume();
+            return empty{};
+        } else if constexpr (std::is_reference_v<R>) {
+            return std::remove_cvref_t<R>(std::move(a.await_resume()));
+        } else {
+            return a.await_resume();
+        }
+    }
+};
+
+/// @brief The awaitable a step of a chain returns, given the result of the step before, if any, which the step may take.
+template <class F, class Prev>
+struct chain_awaitable {
+    using type = typename std::conditional_t<std::is_invocable_v<F &, Prev &>,
+                                             std::invoke_result<F &, Prev &>,
+                                             std::invoke_result<F &>>::type;
+};
+template <class F>
+struct chain_awaitable<F, void> {
+    using type = std::invoke_result_t<F &>;
+};
+
+/// @brief The std::tuple of the results of a chain's steps.
+template <class Prev, class... F>
+struct chain_results {
+    using type = std::tuple<>;
+};
+template <class Prev, class F, class... Rest>
+struct chain_results<Prev, F, Rest...> {
+    using result = decltype(std::declval<chain_step<
+                                typename chain_awaitable<F, Prev>::type> &>()
+                                .await_resume());
+    using type   = decltype(std::tuple_cat(
+        std::declval<std::tuple<result>>(),
+        std::declval<typename chain_results<result, Rest...>::type>()));
+};
+
+/// @brief Starts step I of a chain, passing it the result of the step before if it takes one.
+template <std::size_t I, class F, class Rs>
+auto start_chain_step(F &f, Rs &rs)
+{
+    if constexpr (I == 0) {
+        return chain_step<std::invoke_result_t<F &>>{f()};
+    } else {
+        auto &prev = *std::get<I - 1>(rs);
+        if constexpr (std::is_invocable_v<F &, decltype(prev)>)
+            return chain_step<std::invoke_result_t<F &, decltype(prev)>>{
+                f(prev)};
+        else
+            return chain_step<std::invoke_result_t<F &>>{f()};
+    }
+}
 } // namespace detail
 constexpr inline std::size_t max_ios = MAXIMUM_WAIT_OBJECTS;
 
+/// @brief Specifies how a context waits for I/O completions.
+enum class wait_mode : unsigned char {
+    /// Go straight into a blocking wait.
+    block,
+    /// Poll for completions up to spin_count times before blocking.
+    spin_then_block,
+    /// Never block; poll for completions until one arrives or the run variant times out.
+    busy_poll
+};
+
+/// @brief A context's wait strategy. There's no kernel-side submission polling to opt into, as waiting on events leaves no such mode to the backend.
+struct wait_policy {
+    /// The number of non-blocking polls to do before blocking in spin_then_block mode.
+    uint32_t spin_count = 4000;
+    wait_mode mode      = wait_mode::block;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
+/// @brief Tells how spinning has fared in the non-blocking wait modes.
+struct spin_stats {
+    /// The number of waits spinning found a completion for, avoiding a blocking wait.
+    std::size_t hits;
+    /// The number of waits that fell back to a blocking wait (or timed out) after spinning.
+    std::size_t misses;
+    /// The total number of non-blocking polls done.
+    std::size_t spins;
+};
+
+/// @brief How many coroutines of each I/O class a context resumes in a row while I/Os of the classes below have completed too, before giving those a turn. Each must be at least 1.
+struct priority_budgets {
+    uint32_t interactive = 8;
+    uint32_t normal      = 4;
+    uint32_t bulk        = 2;
+};
+
 /// @brief Orchestrates the awaiting of asynchronous I/Os.
 /// @tparam AtomicIos Whether it's possible for multiple I/O submissions to happen simultaneously. Required by AsyncIos.
 /// @tparam AsyncIos Whether it's possible for an I/O to be submitted while WaitForMultipleObjects is ongoing.
@@ -45,14 +195,35 @@ class context
     using coro_ptr =
         std::conditional_t<KORU_DEBUG, std::coroutine_handle<>, void *>;
 
+    // Points to where to store the coro awaiting an operation. If submissions
+    // can happen simultaneously, the lock is held until the coro is stored.
+    struct ptr {
+        constexpr KORU_inline ptr(const auto &) {}
+        KORU_defctor(ptr, = delete;);
+        coro_ptr *p;
+    };
+    struct ptr_and_lock : detail::lock<false> {
+        constexpr KORU_inline ptr_and_lock(auto &x)
+            : detail::lock<false>{x.srwl}
+        {
+        }
+        KORU_defctor(ptr_and_lock, = delete;);
+        coro_ptr *p;
+    };
+    using slot_ptr = std::conditional_t<AtomicIos, ptr_and_lock, ptr>;
+
+    // Reports failures as values if Nothrow, or by throwing otherwise.
+    // Reading at or past the end of the file reads 0 bytes, unlike in WinAPI.
+    template <bool Nothrow>
     class file_task
     {
         friend class context;
 
         template <class OpT, class BufT>
         KORU_inline file_task(context &c, OpT op, detail::HANDLE hfile,
-                              uint64_t offset, BufT buf, detail::DWORD nbytes)
-            : last_{c.last_}
+                              uint64_t offset, BufT buf, detail::DWORD nbytes,
+                              const io_priority prio)
+            : h_{hfile}, last_{c.last_}
         {
             ol_.Offset     = static_cast<uint32_t>(offset);
             ol_.OffsetHigh = static_cast<uint32_t>(offset >> 32);
@@ -65,12 +236,19 @@ class context
                 last_.p = nullptr;
                 if constexpr (AtomicIos)
                     last_.unlock();
-            } else if (GetLastError() != ERROR_IO_PENDING) {
+            } else if (const auto err = GetLastError();
+                       err != ERROR_IO_PENDING) {
                 // Error occurred
-                detail::throw_last_winapi_error();
+                if constexpr (!Nothrow)
+                    if (err != ERROR_HANDLE_EOF)
+                        detail::throw_last_winapi_error();
+                err_    = err;
+                last_.p = nullptr;
+                if constexpr (AtomicIos)
+                    last_.unlock();
             } else {
                 // Async I/O initiated successfully
-                last_.p = &c.coros_[c.last_.sz++];
+                last_.p = c.claim_slot(prio);
                 if constexpr (AsyncIos)
                     SetEvent(c.evs_[0]);
             }
@@ -80,10 +258,489 @@ class context
         KORU_defctor(file_task, = delete;);
 
         bool await_ready() const noexcept { return !last_.p; }
-        auto await_resume() const noexcept
+        std::size_t await_resume() requires(!Nothrow)
+        {
+            const auto res = result();
+            if (!res) [[unlikely]]
+                throw std::system_error{res.error()};
+            return *res;
+        }
+        expected<std::size_t, std::error_code>
+        await_resume() noexcept requires Nothrow
+        {
+            return result();
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            *last_.p = h KORU_ndbg(.address());
+            if constexpr (AtomicIos)
+                last_.unlock();
+        }
+
+      private:
+        expected<std::size_t, std::error_code> result() noexcept
+        {
+            if (!err_ && !ol_.Internal) [[likely]]
+                return std::bit_cast<std::size_t>(ol_.InternalHigh);
+            const auto err = err_ ? err_ : detail::overlapped_error(h_, ol_);
+            if (err == ERROR_HANDLE_EOF)
+                return std::size_t{0};
+            return unexpected{detail::winapi_error(err)};
+        }
+
+        detail::OVERLAPPED ol_;
+        detail::HANDLE h_;
+        detail::DWORD err_ = 0;
+        slot_ptr last_;
+    };
+
+    // Like file_task, but for sockets, whose errors are WSA error codes
+    template <bool Nothrow>
+    class socket_task
+    {
+        friend class context;
+
+        template <class OpT>
+        KORU_inline socket_task(context &c, OpT op, const detail::SOCKET s,
+                                void *const buf, const uint32_t nbytes,
+                                const io_priority prio)
+            : s_{s}, last_{c.last_}
+        {
+            // Unlike ReadFile and WriteFile, WSARecv and WSASend don't reset
+            // the event when they're started
+            ol_.hEvent =
+                detail::or_(c.evs_[c.last_.sz], KORU_fref(detail::CreateEventW),
+                            nullptr, false, false, nullptr);
+            ResetEvent(ol_.hEvent);
+
+            detail::WSABUF wb{nbytes, static_cast<char *>(buf)};
+            if (op(s, wb, ol_) == 0) {
+                // I/O completed synchronously
+                last_.p = nullptr;
+                if constexpr (AtomicIos)
+                    last_.unlock();
+            } else if (const auto err = WSAGetLastError();
+                       err != ERROR_IO_PENDING) {
+                // Error occurred
+                if constexpr (!Nothrow)
+                    detail::throw_last_wsa_error();
+                err_    = err;
+                last_.p = nullptr;
+                if constexpr (AtomicIos)
+                    last_.unlock();
+            } else {
+                // Async I/O initiated successfully
+                last_.p = c.claim_slot(prio);
+                if constexpr (AsyncIos)
+                    SetEvent(c.evs_[0]);
+            }
+        }
+
+      public:
+        KORU_defctor(socket_task, = delete;);
+
+        bool await_ready() const noexcept { return !last_.p; }
+        std::size_t await_resume() requires(!Nothrow)
+        {
+            const auto res = result();
+            if (!res) [[unlikely]]
+                throw std::system_error{res.error()};
+            return *res;
+        }
+        expected<std::size_t, std::error_code>
+        await_resume() noexcept requires Nothrow
+        {
+            return result();
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            *last_.p = h KORU_ndbg(.address());
+            if constexpr (AtomicIos)
+                last_.unlock();
+        }
+
+      private:
+        expected<std::size_t, std::error_code> result() noexcept
+        {
+            if (!err_ && !ol_.Internal) [[likely]]
+                return std::bit_cast<std::size_t>(ol_.InternalHigh);
+            return unexpected{detail::wsa_error(
+                err_ ? err_ : detail::overlapped_wsa_error(s_, ol_))};
+        }
+
+        detail::OVERLAPPED ol_;
+        detail::SOCKET s_;
+        int err_ = 0;
+        slot_ptr last_;
+    };
+
+    static int recv_op(const detail::SOCKET s, detail::WSABUF &wb,
+                       detail::OVERLAPPED &ol) noexcept
+    {
+        detail::DWORD flags = 0;
+        return detail::WSARecv(s, &wb, 1, nullptr, &flags, &ol);
+    }
+
+    static int send_op(const detail::SOCKET s, detail::WSABUF &wb,
+                       detail::OVERLAPPED &ol) noexcept
+    {
+        return detail::WSASend(s, &wb, 1, nullptr, 0, &ol);
+    }
+
+    // Transfers as many datagrams as possible without blocking, suspending
+    // only while not even the first can be. An error past the first
+    // datagram ends the batch early; it's thrown by the next transfer, which
+    // starts with the datagram that failed.
+    template <bool Send>
+    class msg_task
+    {
+        friend class context;
+
+        KORU_inline msg_task(context &c, const detail::SOCKET s,
+                             const std::span<msg_buf> msgs,
+                             const io_priority prio)
+            : s_{s}, msgs_{msgs}, last_{c.last_}
+        {
+            int err = 0;
+            n_      = detail::transfer_available(s, msgs.data(), msgs.size(),
+                                                 Send, err);
+            if (n_ || msgs.empty()) {
+                last_.p = nullptr;
+                if constexpr (AtomicIos)
+                    last_.unlock();
+                return;
+            }
+            if (err) [[unlikely]]
+                throw std::system_error{detail::wsa_error(err)};
+
+            // Nothing could be transferred right away; await the first
+            // datagram with an overlapped operation
+            ol_.hEvent =
+                detail::or_(c.evs_[c.last_.sz], KORU_fref(detail::CreateEventW),
+                            nullptr, false, false, nullptr);
+            ResetEvent(ol_.hEvent);
+            detail::WSABUF wb{msgs[0].size, static_cast<char *>(msgs[0].data)};
+            if ((Send ? send_op(s, wb, ol_) : recv_op(s, wb, ol_)) == 0) {
+                last_.p = nullptr;
+                if constexpr (AtomicIos)
+                    last_.unlock();
+            } else if (WSAGetLastError() != ERROR_IO_PENDING) {
+                detail::throw_last_wsa_error();
+            } else {
+                last_.p = c.claim_slot(prio);
+                if constexpr (AsyncIos)
+                    SetEvent(c.evs_[0]);
+            }
+        }
+
+      public:
+        KORU_defctor(msg_task, = delete;);
+
+        bool await_ready() const noexcept { return !last_.p; }
+        std::size_t await_resume()
+        {
+            if (n_ || msgs_.empty())
+                return n_;
+            msgs_[0].truncated = false;
+            if (ol_.Internal) [[unlikely]] {
+                const auto err = detail::overlapped_wsa_error(s_, ol_);
+                if (Send || err != WSAEMSGSIZE)
+                    throw std::system_error{detail::wsa_error(err)};
+                msgs_[0].truncated = true;
+            }
+            msgs_[0].nbytes = static_cast<uint32_t>(ol_.InternalHigh);
+            // Pick up whatever else became transferable meanwhile
+            int err;
+            return 1 + detail::transfer_available(s_, msgs_.data() + 1,
+                                                  msgs_.size() - 1, Send, err);
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            *last_.p = h KORU_ndbg(.address());
+            if constexpr (AtomicIos)
+                last_.unlock();
+        }
+
+      private:
+        detail::OVERLAPPED ol_;
+        detail::SOCKET s_;
+        std::span<msg_buf> msgs_;
+        std::size_t n_;
+        slot_ptr last_;
+    };
+
+    class accept_task
+    {
+        friend class context;
+
+        KORU_inline accept_task(context &c, const detail::SOCKET listener,
+                                const io_priority prio)
+            : ls_{listener}, s_{detail::create_accept_socket(listener)},
+              last_{c.last_}
+        {
+            ol_.hEvent =
+                detail::or_(c.evs_[c.last_.sz], KORU_fref(detail::CreateEventW),
+                            nullptr, false, false, nullptr);
+            ResetEvent(ol_.hEvent);
+
+            detail::DWORD nbytes;
+            if (detail::AcceptEx(ls_, s_, &addrs_[0], 0,
+                                 detail::accept_addr_size,
+                                 detail::accept_addr_size, &nbytes, &ol_)) {
+                // A connection was already waiting
+                last_.p = nullptr;
+                if constexpr (AtomicIos)
+                    last_.unlock();
+            } else if (const auto err = WSAGetLastError();
+                       err != ERROR_IO_PENDING) {
+                closesocket(s_);
+                throw std::system_error{detail::wsa_error(err)};
+            } else {
+                last_.p = c.claim_slot(prio);
+                if constexpr (AsyncIos)
+                    SetEvent(c.evs_[0]);
+            }
+        }
+
+      public:
+        KORU_defctor(accept_task, = delete;);
+        ~accept_task()
+        {
+            if (s_ != INVALID_SOCKET)
+                closesocket(s_);
+        }
+
+        bool await_ready() const noexcept { return !last_.p; }
+        detail::socket await_resume()
+        {
+            if (ol_.Internal) [[unlikely]]
+                throw std::system_error{
+                    detail::wsa_error(detail::overlapped_wsa_error(ls_, ol_))};
+            detail::finish_accept(ls_, s_);
+            return {std::exchange(s_, INVALID_SOCKET)};
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            *last_.p = h KORU_ndbg(.address());
+            if constexpr (AtomicIos)
+                last_.unlock();
+        }
+
+      private:
+        detail::OVERLAPPED ol_;
+        detail::SOCKET ls_, s_;
+        char addrs_[2 * detail::accept_addr_size];
+        slot_ptr last_;
+    };
+
+    class connect_task
+    {
+        friend class context;
+
+        KORU_inline connect_task(context &c, const detail::endpoint &ep)
+            : s_{detail::create_connect_socket(ep)}, last_{c.last_}
+        {
+            ol_.hEvent =
+                detail::or_(c.evs_[c.last_.sz], KORU_fref(detail::CreateEventW),
+                            nullptr, false, false, nullptr);
+            ResetEvent(ol_.hEvent);
+
+            if (detail::ConnectEx(s_, &ep.addr[0], ep.addrlen, nullptr, 0,
+                                  nullptr, &ol_)) {
+                last_.p = nullptr;
+                if constexpr (AtomicIos)
+                    last_.unlock();
+            } else if (const auto err = WSAGetLastError();
+                       err != ERROR_IO_PENDING) {
+                closesocket(s_);
+                throw std::system_error{detail::wsa_error(err)};
+            } else {
+                last_.p = c.claim_slot(io_priority::normal);
+                if constexpr (AsyncIos)
+                    SetEvent(c.evs_[0]);
+            }
+        }
+
+      public:
+        KORU_defctor(connect_task, = delete;);
+        ~connect_task()
+        {
+            if (s_ != INVALID_SOCKET)
+                closesocket(s_);
+        }
+
+        bool await_ready() const noexcept { return !last_.p; }
+        detail::socket await_resume()
+        {
+            if (ol_.Internal) [[unlikely]]
+                throw std::system_error{
+                    detail::wsa_error(detail::overlapped_wsa_error(s_, ol_))};
+            detail::finish_connect(s_);
+            return {std::exchange(s_, INVALID_SOCKET)};
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            *last_.p = h KORU_ndbg(.address());
+            if constexpr (AtomicIos)
+                last_.unlock();
+        }
+
+      private:
+        detail::OVERLAPPED ol_;
+        detail::SOCKET s_;
+        slot_ptr last_;
+    };
+
+    template <class F>
+    class offload_task : detail::offload_job
+    {
+        friend class context;
+
+        using R = std::invoke_result_t<F &>;
+        static_assert(!std::is_reference_v<R>,
+                      "offloaded functions must return by value");
+
+        template <class G>
+        offload_task(context &c, G &&g)
+            : detail::offload_job{nullptr, &invoke, nullptr},
+              f_{static_cast<G &&>(g)}, last_{c.last_}
+        {
+            if (!c.pool_)
+                c.pool_ =
+                    std::make_unique<detail::offload_pool>(c.offload_limits_);
+            // Unlike I/Os, jobs don't reset the event when they're started;
+            // it may have been left signaled by a synchronously completed I/O.
+            ev = detail::or_(c.evs_[c.last_.sz],
+                             KORU_fref(detail::CreateEventW), nullptr, false,
+                             false, nullptr);
+            ResetEvent(ev);
+
+            if (c.pool_->submit(*this)) {
+                last_.p = c.claim_slot(io_priority::normal);
+                if constexpr (AsyncIos)
+                    SetEvent(c.evs_[0]);
+            } else {
+                // Queue is full; run the job on this thread instead
+                last_.p = nullptr;
+                if constexpr (AtomicIos)
+                    last_.unlock();
+                c.pool_->count_inlined();
+                invoke(this);
+            }
+        }
+
+        static void invoke(detail::offload_job *const job) noexcept
+        {
+            auto &t = *static_cast<offload_task *>(job);
+            try {
+                if constexpr (std::is_void_v<R>)
+                    t.f_();
+                else
+                    t.res_.emplace(t.f_());
+            } catch (...) {
+                t.ep_ = std::current_exception();
+            }
+        }
+
+      public:
+        KORU_defctor(offload_task, = delete;);
+
+        bool await_ready() const noexcept { return !last_.p; }
+        R await_resume()
+        {
+            if (ep_) [[unlikely]]
+                std::rethrow_exception(ep_);
+            if constexpr (!std::is_void_v<R>)
+                return static_cast<R &&>(*res_);
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            *last_.p = h KORU_ndbg(.address());
+            if constexpr (AtomicIos)
+                last_.unlock();
+        }
+
+      private:
+        F f_;
+        std::conditional_t<std::is_void_v<R>, detail::empty, std::optional<R>>
+            res_;
+        std::exception_ptr ep_;
+        slot_ptr last_;
+    };
+
+    static detail::HANDLE open_handle(const wchar_t *fname, const access acs)
+    {
+        const auto handle = detail::CreateFileW(
+            fname, static_cast<detail::DWORD>(acs),
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+            static_cast<detail::DWORD>(acs == access::read ? OPEN_EXISTING
+                                                           : OPEN_ALWAYS),
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            detail::throw_last_winapi_error();
+        return handle;
+    }
+
+    struct open_fn {
+        const wchar_t *fname;
+        access acs;
+        detail::HANDLE operator()() const { return open_handle(fname, acs); }
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+    class open_task : public offload_task<open_fn>
+    {
+        friend class context;
+
+        KORU_inline open_task(context &c, const open_fn f)
+            : offload_task<open_fn>{c, f}
+        {
+        }
+
+      public:
+        KORU_defctor(open_task, = delete;);
+
+        detail::file await_resume()
+        {
+            return {offload_task<open_fn>::await_resume()};
+        }
+    };
+
+    class timer_task
+    {
+        friend class context;
+
+        KORU_inline timer_task(context &c, const detail::DWORD ms)
+            : last_{c.last_}
+        {
+            if (!ms) {
+                last_.p = nullptr;
+                if constexpr (AtomicIos)
+                    last_.unlock();
+                return;
+            }
+            // Timers only ever set the event, so it must start out reset
+            const auto ev =
+                detail::or_(c.evs_[c.last_.sz], KORU_fref(detail::CreateEventW),
+                            nullptr, false, false, nullptr);
+            ResetEvent(ev);
+            timer_  = detail::start_timer(ev, ms);
+            ev_     = ev;
+            last_.p = c.claim_slot(io_priority::normal);
+            if constexpr (AsyncIos)
+                SetEvent(c.evs_[0]);
+        }
+
+      public:
+        KORU_defctor(timer_task, = delete;);
+        ~timer_task()
         {
-            return std::bit_cast<std::size_t>(ol_.InternalHigh);
+            if (timer_)
+                detail::stop_timer(timer_);
         }
+
+        bool await_ready() const noexcept { return !last_.p; }
+        constexpr void await_resume() const noexcept {}
         void await_suspend(std::coroutine_handle<> h)
         {
             *last_.p = h KORU_ndbg(.address());
@@ -91,25 +748,46 @@ class context
                 last_.unlock();
         }
 
+        /// @brief Ends the sleep early, as if it were due; for another coroutine to call while *this is awaited on.
+        void wake() const noexcept
+        {
+            if (ev_)
+                SetEvent(ev_);
+        }
+
       private:
-        detail::OVERLAPPED ol_;
-        struct ptr {
-            constexpr KORU_inline ptr(const auto &) {}
-            KORU_defctor(ptr, = delete;);
-            coro_ptr *p;
-        };
-        struct ptr_and_lock : detail::lock<false> {
-            constexpr KORU_inline ptr_and_lock(auto &x)
-                : detail::lock<false>{x.srwl}
-            {
-            }
-            KORU_defctor(ptr_and_lock, = delete;);
-            coro_ptr *p;
-        };
-        std::conditional_t<AtomicIos, ptr_and_lock, ptr> last_;
+        detail::HANDLE timer_ = nullptr, ev_ = nullptr;
+        slot_ptr last_;
+    };
+
+    class schedule_task : detail::ready_node
+    {
+        friend class context;
+
+        KORU_inline schedule_task(context &c) noexcept
+            : detail::ready_node{}, c_{c}
+        {
+        }
+
+      public:
+        KORU_defctor(schedule_task, = delete;);
+
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            this->h = h;
+            c_.post(*this);
+        }
+        constexpr void await_resume() const noexcept {}
+
+      private:
+        context &c_;
     };
 
   public:
+    /// @brief The maximum number of simultaneously awaited-on operations.
+    static constexpr std::size_t capacity = MaxIos;
+
     [[nodiscard]] KORU_defctor(context, {
         if (detail::WSAStartup(MAKEWORD(2, 2), &wsadata) != 0)
             detail::throw_last_wsa_error();
@@ -117,6 +795,7 @@ class context
 
     ~context()
     {
+        pool_.reset();
         WSACleanup();
         for (int sz = 0; evs_[sz]; ++sz) {
             [[maybe_unused]] const auto res = CloseHandle(evs_[sz]);
@@ -136,25 +815,144 @@ class context
         const detail::ADDRINFOW hints{.ai_family   = ii.family,
                                       .ai_socktype = ii.socktype,
                                       .ai_protocol = ii.protocol};
-        return {detail::create_socket(node, service, hints)};
+        return {detail::create_socket(node, service, hints,
+                                      detail::socket_role::none)};
+    }
+
+    /// @brief Creates a socket that can be operated on by *this, bound to a local address to receive on.
+    /// @param node String denoting a local host name or numeric address, or nullptr for all local addresses.
+    /// @param service String denoting a service name or port number.
+    /// @param ii The desired protocol family and socket type.
+    /// @return An object that represents the created socket.
+    [[nodiscard]] KORU_inline detail::socket
+    bind(const wchar_t *const node, const wchar_t *const service,
+         const detail::inet_info ii)
+    {
+        const detail::ADDRINFOW hints{.ai_flags    = AI_PASSIVE,
+                                      .ai_family   = ii.family,
+                                      .ai_socktype = ii.socktype,
+                                      .ai_protocol = ii.protocol};
+        return {detail::create_socket(node, service, hints,
+                                      detail::socket_role::bind)};
+    }
+
+    /// @brief Creates a stream socket that can be operated on by *this, listening for connections on a local address; see accept().
+    /// @param node String denoting a local host name or numeric address, or nullptr for all local addresses.
+    /// @param service String denoting a service name or port number.
+    /// @param ii The desired protocol family and socket type.
+    /// @return An object that represents the created socket.
+    [[nodiscard]] KORU_inline detail::socket
+    listen(const wchar_t *const node, const wchar_t *const service,
+           const detail::inet_info ii = tcp)
+    {
+        const detail::ADDRINFOW hints{.ai_flags    = AI_PASSIVE,
+                                      .ai_family   = ii.family,
+                                      .ai_socktype = ii.socktype,
+                                      .ai_protocol = ii.protocol};
+        return {detail::create_socket(node, service, hints,
+                                      detail::socket_role::listen)};
+    }
+
+    /// @brief Creates a socket that can be operated on by *this, connected to a remote address. Blocks the calling thread while connecting a stream socket; connecting a datagram socket merely sets the address it sends to and receives from.
+    /// @param node String denoting a host name or numeric address.
+    /// @param service String denoting a service name or port number.
+    /// @param ii The desired protocol family and socket type.
+    /// @return An object that represents the created socket.
+    [[nodiscard]] KORU_inline detail::socket
+    connect(const wchar_t *const node, const wchar_t *const service,
+            const detail::inet_info ii)
+    {
+        const detail::ADDRINFOW hints{.ai_family   = ii.family,
+                                      .ai_socktype = ii.socktype,
+                                      .ai_protocol = ii.protocol};
+        return {detail::create_socket(node, service, hints,
+                                      detail::socket_role::connect)};
+    }
+
+    /// @brief Looks up the remote address to connect to. Blocks the calling thread.
+    /// @param node String denoting a host name or numeric address.
+    /// @param service String denoting a service name or port number.
+    /// @param ii The desired protocol family and socket type.
+    /// @return The first address found, for connect() to take.
+    [[nodiscard]] static detail::endpoint
+    resolve(const wchar_t *const node, const wchar_t *const service,
+            const detail::inet_info ii = tcp)
+    {
+        const detail::ADDRINFOW hints{.ai_family   = ii.family,
+                                      .ai_socktype = ii.socktype,
+                                      .ai_protocol = ii.protocol};
+        return detail::resolve(node, service, hints);
     }
 
-    /// @brief Opens a file that can be operated on by *this.
+    /// @brief Opens a file that can be operated on by *this. Blocks the calling thread; see open() for a non-blocking alternative.
     /// @param fname WinAPI-conformant path specifier denoting a file.
     /// @param acs Kind of operations allowed on the file.
     /// @return An object that represents the opened file.
     [[nodiscard]] detail::file file(const wchar_t *fname,
                                     const access acs = access::read)
     {
-        const auto handle = detail::CreateFileW(
-            fname, static_cast<detail::DWORD>(acs),
-            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
-            static_cast<detail::DWORD>(acs == access::read ? OPEN_EXISTING
-                                                           : OPEN_ALWAYS),
-            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
-        if (handle == INVALID_HANDLE_VALUE)
-            detail::throw_last_winapi_error();
-        return {handle};
+        return {open_handle(fname, acs)};
+    }
+
+    /// @brief Opens a file that can be operated on by *this, doing so on the thread pool of *this.
+    /// @param fname WinAPI-conformant path specifier denoting a file; must stay valid until the task completes.
+    /// @param acs Kind of operations allowed on the file.
+    /// @return Task object resulting in an object that represents the opened file; must be awaited on immediately.
+    [[nodiscard]] KORU_inline open_task open(const wchar_t *fname,
+                                             const access acs = access::read)
+    {
+        return {*this, open_fn{fname, acs}};
+    }
+
+    /// @brief Closes a file on the thread pool of *this. Afterwards, the file must not be operated on.
+    /// @param f A file opened by *this.
+    /// @return Task object representing the operation; must be awaited on immediately.
+    [[nodiscard]] KORU_inline auto close(detail::file &f)
+    {
+        f.owned_ = false;
+        return offload([h = f.native_handle] {
+            if (!CloseHandle(h))
+                detail::throw_last_winapi_error();
+        });
+    }
+
+    /// @brief Queries the metadata of a file on the thread pool of *this.
+    /// @param f A file opened by *this.
+    /// @return Task object resulting in the metadata; must be awaited on immediately.
+    [[nodiscard]] KORU_inline auto stat(const detail::file &f)
+    {
+        return offload(
+            [h = f.native_handle] { return detail::get_file_stat(h); });
+    }
+
+    /// @brief Flushes the data and metadata of a file to the storage device on the thread pool of *this.
+    /// @param f A file opened by *this with write access.
+    /// @return Task object representing the operation; must be awaited on immediately.
+    [[nodiscard]] KORU_inline auto fsync(const detail::file &f)
+    {
+        return offload([h = f.native_handle] { detail::flush(h, false); });
+    }
+
+    /// @brief Like fsync(), but skips flushing metadata that isn't needed to read the data back, where the system supports doing so.
+    /// @param f A file opened by *this with write access.
+    /// @return Task object representing the operation; must be awaited on immediately.
+    [[nodiscard]] KORU_inline auto fdatasync(const detail::file &f)
+    {
+        return offload([h = f.native_handle] { detail::flush(h, true); });
+    }
+
+    /// @brief Reserves disk space for a byte range of a file on the thread pool of *this, extending the file if the range ends past its end.
+    /// @param f A file opened by *this with write access.
+    /// @param offset The offset of the range in bytes.
+    /// @param nbytes The size of the range in bytes.
+    /// @return Task object representing the operation; must be awaited on immediately.
+    [[nodiscard]] KORU_inline auto allocate(const detail::file &f,
+                                            const uint64_t offset,
+                                            const uint64_t nbytes)
+    {
+        return offload([=, h = f.native_handle] {
+            detail::allocate(h, offset, nbytes);
+        });
     }
 
     /// @brief Initiates the read of file that completes either synchronously or asynchronously.
@@ -162,11 +960,21 @@ class context
     /// @param buf A pointer denoting the recipient buffer.
     /// @param nbytes The maximum number of bytes to read.
     /// @return Task object representing the file operation; must be awaited on immediately.
-    [[nodiscard]] KORU_inline file_task read(const detail::file::location l,
-                                             void *const buf,
-                                             const uint32_t nbytes)
+    [[nodiscard]] KORU_inline file_task<false>
+    read(const detail::file::location l, void *const buf, const uint32_t nbytes)
+    {
+        return {*this, KORU_fref(ReadFile), l.handle, l.offset, buf, nbytes,
+                l.priority};
+    }
+
+    /// @brief Like read(), but failures are reported as values rather than thrown.
+    /// @return Task object resulting in the number of bytes read or the error that occurred; must be awaited on immediately.
+    [[nodiscard]] KORU_inline file_task<true>
+    try_read(const detail::file::location l, void *const buf,
+             const uint32_t nbytes)
     {
-        return {*this, KORU_fref(ReadFile), l.handle, l.offset, buf, nbytes};
+        return {*this, KORU_fref(ReadFile), l.handle, l.offset, buf, nbytes,
+                l.priority};
     }
 
     /// @brief Initiates the write of file that completes either synchronously or asynchronously.
@@ -174,14 +982,187 @@ class context
     /// @param buf A pointer denoting the source buffer.
     /// @param nbytes The maximum number of bytes to write.
     /// @return Task object representing the file operation; must be awaited on immediately.
-    [[nodiscard]] KORU_inline file_task write(const detail::file::location l,
-                                              const void *const buf,
-                                              const uint32_t nbytes)
+    [[nodiscard]] KORU_inline file_task<false>
+    write(const detail::file::location l, const void *const buf,
+          const uint32_t nbytes)
+    {
+        return {*this, KORU_fref(WriteFile), l.handle, l.offset, buf, nbytes,
+                l.priority};
+    }
+
+    /// @brief Like write(), but failures are reported as values rather than thrown.
+    /// @return Task object resulting in the number of bytes written or the error that occurred; must be awaited on immediately.
+    [[nodiscard]] KORU_inline file_task<true>
+    try_write(const detail::file::location l, const void *const buf,
+              const uint32_t nbytes)
+    {
+        return {*this, KORU_fref(WriteFile), l.handle, l.offset, buf, nbytes,
+                l.priority};
+    }
+
+    /// @brief Initiates the receipt of data on a connected socket that completes either synchronously or asynchronously.
+    /// @param s A socket created by *this.
+    /// @param buf A pointer denoting the recipient buffer.
+    /// @param nbytes The maximum number of bytes to receive.
+    /// @return Task object resulting in the number of bytes received, 0 meaning the peer has closed the connection; must be awaited on immediately.
+    [[nodiscard]] KORU_inline socket_task<false>
+    recv(const detail::socket &s, void *const buf, const uint32_t nbytes)
+    {
+        return {*this, &recv_op, s.native_handle, buf, nbytes, s.priority()};
+    }
+
+    /// @brief Like recv(), but failures, e.g., connection resets, are reported as values rather than thrown.
+    /// @return Task object resulting in the number of bytes received or the error that occurred; must be awaited on immediately.
+    [[nodiscard]] KORU_inline socket_task<true>
+    try_recv(const detail::socket &s, void *const buf, const uint32_t nbytes)
+    {
+        return {*this, &recv_op, s.native_handle, buf, nbytes, s.priority()};
+    }
+
+    /// @brief Initiates the sending of data on a connected socket that completes either synchronously or asynchronously.
+    /// @param s A socket created by *this.
+    /// @param buf A pointer denoting the source buffer.
+    /// @param nbytes The number of bytes to send.
+    /// @return Task object resulting in the number of bytes sent; must be awaited on immediately.
+    [[nodiscard]] KORU_inline socket_task<false>
+    send(const detail::socket &s, const void *const buf, const uint32_t nbytes)
+    {
+        return {*this, &send_op, s.native_handle, const_cast<void *>(buf),
+                nbytes, s.priority()};
+    }
+
+    /// @brief Like send(), but failures are reported as values rather than thrown.
+    /// @return Task object resulting in the number of bytes sent or the error that occurred; must be awaited on immediately.
+    [[nodiscard]] KORU_inline socket_task<true>
+    try_send(const detail::socket &s, const void *const buf,
+             const uint32_t nbytes)
+    {
+        return {*this, &send_op, s.native_handle, const_cast<void *>(buf),
+                nbytes, s.priority()};
+    }
+
+    /// @brief Initiates the acceptance of a connection that completes either synchronously or asynchronously. Several accepts may be outstanding on a socket at once, from one context or several.
+    /// @param s A socket created by listen().
+    /// @return Task object resulting in the connected socket; must be awaited on immediately.
+    [[nodiscard]] KORU_inline accept_task accept(const detail::socket &s)
+    {
+        return {*this, s.native_handle, s.priority()};
+    }
+
+    /// @brief Initiates connecting a stream socket to a resolved address, which completes either synchronously or asynchronously without blocking the calling thread.
+    /// @param ep An address returned by resolve().
+    /// @return Task object resulting in the connected socket; must be awaited on immediately.
+    [[nodiscard]] KORU_inline connect_task connect(const detail::endpoint &ep)
+    {
+        return {*this, ep};
+    }
+
+    /// @brief Receives the datagrams queued on a socket, one per buffer, suspending only while none is. Windows has no recvmmsg, so each datagram takes a call, but none waits for more than the first.
+    /// @param s A datagram socket created by *this.
+    /// @param msgs Buffers to receive into, each getting its nbytes set once filled, and truncated if the datagram didn't fit; must stay valid until the task completes.
+    /// @return Task object resulting in the number of datagrams received, at least 1 unless msgs is empty; must be awaited on immediately.
+    [[nodiscard]] KORU_inline msg_task<false>
+    recv_many(const detail::socket &s, const std::span<msg_buf> msgs)
+    {
+        return {*this, s.native_handle, msgs, s.priority()};
+    }
+
+    /// @brief Sends datagrams, one per buffer, until the socket's send buffer is full, suspending only while not even the first fits. To send equally sized datagrams in a single call, see socket::set_send_segment_size().
+    /// @param s A datagram socket created by *this.
+    /// @param msgs Buffers to send, each getting its nbytes set once sent; must stay valid until the task completes.
+    /// @return Task object resulting in the number of datagrams sent, at least 1 unless msgs is empty; must be awaited on immediately.
+    [[nodiscard]] KORU_inline msg_task<true>
+    send_many(const detail::socket &s, const std::span<msg_buf> msgs)
+    {
+        return {*this, s.native_handle, msgs, s.priority()};
+    }
+
+    /// @brief Runs operations one after another as a unit, each started once the one before completes, the first to fail ending the chain. A convenience over awaiting the steps in turn: Windows has no linked submissions, so each step still gets submitted, and completed, on its own.
+    /// @param fs Callables each starting an operation, e.g., [&] { return ctx.read(...); }, called in order; one taking the result of the step before gets passed it, e.g., the number of bytes read to write. Steps may also be sync_tasks of their own.
+    /// @return Task resulting in a std::tuple of the results of the steps, which must be movable, detail::empty standing for none; rethrows the exception of the first step failing, skipping the rest.
+    template <class... F>
+    [[nodiscard]] sync_task<typename detail::chain_results<void, F...>::type>
+    chain(F... fs)
+    {
+        return run_chain(std::index_sequence_for<F...>{},
+                         std::tuple<F...>{std::move(fs)...});
+    }
+
+    /// @brief Runs a blocking function on the thread pool of *this, resuming the awaiting coroutine on the thread running *this once done. If the pool's queue is full, the function is run inline instead.
+    /// @param f The function to run; its result or exception is relayed to the awaiting coroutine.
+    /// @return Task object representing the operation; must be awaited on immediately.
+    template <class F>
+    [[nodiscard]] KORU_inline offload_task<std::decay_t<F>> offload(F &&f)
     {
-        return {*this, KORU_fref(WriteFile), l.handle, l.offset, buf, nbytes};
+        return {*this, static_cast<F &&>(f)};
+    }
+
+    /// @brief Sets the bounds of the thread pool backing offload(). Only takes effect if called before the first call to offload().
+    void set_offload_limits(const offload_limits l) noexcept
+    {
+        offload_limits_ = l;
+    }
+
+    /// @return Counters describing the use of the thread pool backing offload().
+    [[nodiscard]] koru::offload_stats offload_stats() const noexcept
+    {
+        return pool_ ? pool_->stats() : koru::offload_stats{};
+    }
+
+    /// @brief Suspends the awaiting coroutine to be resumed by the thread running *this. Cross-thread use requires AsyncIos, lest the coroutine only get resumed once the run loop looks for work the next time.
+    /// @return Task object representing the scheduling; must be awaited on immediately.
+    [[nodiscard]] KORU_inline schedule_task schedule() noexcept
+    {
+        return {*this};
+    }
+
+    /// @brief Suspends the awaiting coroutine for the given duration, occupying an I/O slot meanwhile. Has millisecond granularity.
+    /// @param d The duration to sleep for; non-positive durations complete immediately.
+    /// @return Task object representing the sleep; must be awaited on immediately.
+    template <class Rep, class Period>
+    [[nodiscard]] KORU_inline timer_task
+    sleep_for(const std::chrono::duration<Rep, Period> &d)
+    {
+        return sleep_until(std::chrono::steady_clock::now() + d);
+    }
+
+    /// @brief Suspends the awaiting coroutine until the given point in time, occupying an I/O slot meanwhile. Has millisecond granularity.
+    /// @param tp The point in time to sleep until; points in the past complete immediately.
+    /// @return Task object representing the sleep; must be awaited on immediately.
+    template <class Clock, class Duration>
+    [[nodiscard]] KORU_inline timer_task
+    sleep_until(const std::chrono::time_point<Clock, Duration> &tp)
+    {
+        return {*this, timeout_until(tp)};
+    }
+
+    /// @brief Enqueues a suspended coroutine to be resumed by the thread running *this. Can be called from any thread if AtomicIos is set.
+    /// @param n The link to enqueue; must stay alive until the coroutine is resumed.
+    void post(detail::ready_node &n) noexcept
+    {
+        n.next = nullptr;
+        {
+            const auto loe = lock_or_empty<false>();
+            (ready_tail_ ? ready_tail_->next : ready_head_) = &n;
+            ready_tail_ = &n;
+        }
+        if constexpr (AsyncIos)
+            SetEvent(evs_[0]);
     }
 
   private:
+    template <std::size_t... I, class... F>
+    static sync_task<typename detail::chain_results<void, F...>::type>
+    run_chain(std::index_sequence<I...>, std::tuple<F...> fs)
+    {
+        using results = typename detail::chain_results<void, F...>::type;
+        std::tuple<std::optional<std::tuple_element_t<I, results>>...> rs;
+        (std::get<I>(rs).emplace(
+             co_await detail::start_chain_step<I>(std::get<I>(fs), rs)),
+         ...);
+        co_return results{std::move(*std::get<I>(rs))...};
+    }
+
     template <bool Shared>
     KORU_inline auto lock_or_empty() noexcept
     {
@@ -191,38 +1172,363 @@ class context
             return detail::empty{};
     }
 
-  public:
-    /// @brief Responds to tracked I/O completions by resuming the corresponding awaiting coroutine. Exits after running out of work.
-    void run()
+    // The outcome of waiting on the tracked events once.
+    enum class wait_result { resumed, notified, timeout };
+
+    // The number of tracked events and whether there are scheduled coros.
+    struct work {
+        int sz;
+        bool ready;
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+    KORU_inline work pending() noexcept
+    {
+        const auto loe = lock_or_empty<true>();
+        return {last_.sz, ready_head_ != nullptr};
+    }
+
+    /// @brief Resumes the coroutines scheduled onto *this. Coroutines scheduled meanwhile are left for the next call.
+    /// @param max The maximum number of coroutines to resume.
+    /// @return The number of coroutines resumed.
+    std::size_t resume_ready(const std::size_t max = SIZE_MAX)
+    {
+        detail::ready_node *last = nullptr;
+        std::size_t n            = 0;
+        while (n < max) {
+            const auto node = [&]() -> detail::ready_node * {
+                const auto loe = lock_or_empty<false>();
+                if (!n)
+                    last = ready_tail_;
+                const auto node = ready_head_;
+                if (node && !(ready_head_ = node->next))
+                    ready_tail_ = nullptr;
+                return node;
+            }();
+            if (!node)
+                break;
+            ++n;
+            const auto was_last = node == last;
+            node->h.resume();
+            if (was_last)
+                break;
+        }
+        return n;
+    }
+
+    // The number of I/O classes, whose slots lie in consecutive ranges
+    static constexpr int nclasses = 3;
+
+    /// @brief Takes the free slot at the end for an I/O of the given class, moving the first slot of each class below to the end of its range to make room. Must be called with last_ locked.
+    /// @return Where to store the coro awaiting the I/O.
+    coro_ptr *claim_slot(const io_priority prio) noexcept
+    {
+        auto idx = last_.sz++;
+        for (auto k = nclasses - 1; k > static_cast<int>(prio); --k) {
+            if (const auto first = begins_[k]++; first != idx) {
+                std::swap(evs_[first], evs_[idx]);
+                coros_[idx] = coros_[first];
+                idx         = first;
+            }
+        }
+        return &coros_[idx];
+    }
+
+    /// @brief Frees a slot, moving the last slot of its class and of each class below into the hole in turn, so that the ranges stay consecutive. Must be called with last_ locked.
+    /// @return The coro that was stored in the slot.
+    coro_ptr release_slot(int idx) noexcept
+    {
+        const auto ptr = coros_[idx];
+        for (auto k = class_of(idx); k < nclasses; ++k) {
+            const auto end  = k + 1 < nclasses ? begins_[k + 1] : last_.sz;
+            const auto last = end - 1;
+            std::swap(evs_[idx], evs_[last]);
+            coros_[idx] = coros_[last];
+            idx         = last;
+            if (k + 1 < nclasses)
+                --begins_[k + 1];
+        }
+        --last_.sz;
+        return ptr;
+    }
+
+    int class_of(const int idx) const noexcept
+    {
+        auto k = nclasses - 1;
+        while (idx < begins_[k])
+            --k;
+        return k;
+    }
+
+    uint32_t budget(const int k) const noexcept
     {
-        auto sz = [&] {
+        return k == 0 ? budgets_.interactive
+                      : k == 1 ? budgets_.normal : budgets_.bulk;
+    }
+
+    bool exhausted() const noexcept
+    {
+        for (auto k = 0; k < nclasses; ++k)
+            if (used_[k] >= budget(k))
+                return true;
+        return false;
+    }
+
+    /// @brief Waits for at most ms milliseconds for an event to be signaled and resumes the coroutine associated with it. WaitForMultipleObjects reports the signaled event with the lowest index, so the higher classes, whose slots come first, win; once a class has used up its budget, the classes with budget left get polled first, and once they have nothing due, every budget starts afresh.
+    /// @param sz The number of events to wait on.
+    /// @param ms The timeout in milliseconds; may be INFINITE.
+    /// @return Whether a coroutine got resumed, the wait got interrupted, or it timed out.
+    wait_result wait_one(const int sz, const detail::DWORD ms)
+    {
+        // Other threads may reorder the slots while submitting, so the wait
+        // goes by a copy of the events then
+        [[maybe_unused]] detail::HANDLE copy[AtomicIos ? nmax : 1];
+        const detail::HANDLE *evs = evs_;
+        int begins[nclasses];
+        {
             const auto loe = lock_or_empty<true>();
-            return last_.sz;
+            if constexpr (AtomicIos) {
+                std::copy_n(evs_, sz, copy);
+                evs = copy;
+            }
+            std::copy_n(begins_, nclasses, begins);
+        }
+
+        auto res = static_cast<detail::DWORD>(WAIT_TIMEOUT);
+        if (exhausted()) {
+            // Poll each run of consecutive classes with budget left
+            for (auto k = 0; k < nclasses && res == WAIT_TIMEOUT;) {
+                if (used_[k] >= budget(k)) {
+                    ++k;
+                    continue;
+                }
+                auto e = k + 1;
+                while (e < nclasses && used_[e] < budget(e))
+                    ++e;
+                const auto first = std::min(begins[k], sz);
+                const auto last  = e < nclasses ? std::min(begins[e], sz) : sz;
+                if (first < last) {
+                    const auto n = static_cast<detail::DWORD>(last - first);
+                    res = WaitForMultipleObjects(n, evs + first, false, 0);
+                    if (res - WAIT_OBJECT_0 < n)
+                        res += static_cast<detail::DWORD>(first);
+                }
+                k = e;
+            }
+            if (res == WAIT_TIMEOUT)
+                std::fill_n(used_, nclasses, 0u);
+        }
+        if (res == WAIT_TIMEOUT)
+            res = wait_any(evs, static_cast<detail::DWORD>(sz), ms);
+        if (res == WAIT_TIMEOUT)
+            return wait_result::timeout;
+        const auto h_idx = static_cast<unsigned>(res - WAIT_OBJECT_0);
+        if (h_idx >= static_cast<unsigned>(sz))
+            detail::throw_last_winapi_error();
+        if constexpr (AsyncIos)
+            if (h_idx == 0)
+                return wait_result::notified;
+
+        // Dequeue and resume the corresponding coro
+        const auto ptr = [&] {
+            const auto loe = lock_or_empty<false>();
+            auto idx       = static_cast<int>(h_idx);
+            if constexpr (AtomicIos)
+                if (evs_[idx] != evs[idx])
+                    idx = static_cast<int>(
+                        std::find(evs_ + init_sz, evs_ + last_.sz, evs[idx]) -
+                        evs_);
+            ++used_[class_of(idx)];
+            return release_slot(idx);
         }();
+        KORU_ndbg(std::coroutine_handle<>::from_address)(ptr).resume();
+        return wait_result::resumed;
+    }
 
-        while (sz != init_sz) {
-            const auto h_idx = static_cast<unsigned>(
-                WaitForMultipleObjects(static_cast<detail::DWORD>(sz), evs_,
-                                       false, INFINITE) -
-                WAIT_OBJECT_0);
-            if (h_idx > static_cast<unsigned>(sz)) {
-                detail::throw_last_winapi_error();
-#pragma warning(suppress : 4127) /* conditional expression is constant */
-            } else if (!AsyncIos || h_idx != 0) {
-                // Dequeue and resume the corresponding coro
-                const auto ptr = [&] {
-                    const auto loe = lock_or_empty<false>();
-                    if constexpr (AsyncIos)
-                        sz = --last_.sz;
-                    else
-                        last_.sz = --sz;
-                    std::swap(evs_[h_idx], evs_[sz]);
-                    return std::exchange(coros_[h_idx], coros_[sz]);
-                }();
-                KORU_ndbg(std::coroutine_handle<>::from_address)(ptr).resume();
+    /// @brief Waits for any of the first n events as per the wait policy.
+    /// @return The WaitForMultipleObjects-conformant result of the wait.
+    detail::DWORD wait_any(const detail::HANDLE *const evs,
+                           const detail::DWORD n, const detail::DWORD ms)
+    {
+        if (ms == 0 || policy_.mode == wait_mode::block)
+            return WaitForMultipleObjects(n, evs, false, ms);
+
+        const auto busy = policy_.mode == wait_mode::busy_poll;
+        const auto t0   = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; busy || i < policy_.spin_count; ++i) {
+            ++spin_stats_.spins;
+            if (const auto res = WaitForMultipleObjects(n, evs, false, 0);
+                res != WAIT_TIMEOUT) {
+                ++spin_stats_.hits;
+                return res;
             }
-            const auto loe = lock_or_empty<true>();
-            sz             = last_.sz;
+            if (busy && ms != INFINITE &&
+                std::chrono::steady_clock::now() - t0 >=
+                    std::chrono::milliseconds{ms}) {
+                ++spin_stats_.misses;
+                return WAIT_TIMEOUT;
+            }
+        }
+        ++spin_stats_.misses;
+        return WaitForMultipleObjects(n, evs, false, ms);
+    }
+
+    template <class Clock, class Duration>
+    static KORU_inline detail::DWORD
+    timeout_until(const std::chrono::time_point<Clock, Duration> &tp)
+    {
+        const auto ms =
+            std::chrono::ceil<std::chrono::milliseconds>(tp - Clock::now())
+                .count();
+        return ms <= 0 ? 0
+                       : static_cast<detail::DWORD>(
+                             std::min<decltype(ms)>(ms, INFINITE - 1));
+    }
+
+  public:
+    /// @brief Sets how run() and its variants wait for I/O completions. Must not be called while any of them is ongoing.
+    /// @param p The wait strategy to use from now on.
+    void set_wait_policy(const koru::wait_policy p) noexcept { policy_ = p; }
+
+    /// @return The wait strategy currently in use.
+    [[nodiscard]] koru::wait_policy wait_policy() const noexcept
+    {
+        return policy_;
+    }
+
+    /// @return Counters telling how often spinning has avoided a blocking wait. Must be read by the thread that runs *this.
+    [[nodiscard]] koru::spin_stats spin_stats() const noexcept
+    {
+        return spin_stats_;
+    }
+
+    /// @brief Sets the class of the I/Os on a file from now on, along with the priority the storage stack gives them where the file system supports it: bulk I/Os get a low one.
+    /// @param f A file opened by *this.
+    /// @param p The class to put the I/Os on f in.
+    /// @return Whether the file system took the priority hint; the class applies either way.
+    bool set_io_priority(detail::file &f, const io_priority p) noexcept
+    {
+        f.priority_ = p;
+        return detail::set_io_priority_hint(f.native_handle, p);
+    }
+
+    /// @brief Sets the class of the I/Os on a socket from now on. Windows has no per-socket priority for the network stack to honor, so the class only decides the order in which *this resumes coroutines.
+    /// @param s A socket created by *this.
+    /// @param p The class to put the I/Os on s in.
+    void set_io_priority(detail::socket &s, const io_priority p) noexcept
+    {
+        s.priority_ = p;
+    }
+
+    /// @brief Sets how many coroutines of each I/O class get resumed in a row while I/Os of the classes below have completed too. Must not be called while run() or any of its variants is ongoing.
+    void set_priority_budgets(const koru::priority_budgets b) noexcept
+    {
+        KORU_assert(b.interactive && b.normal && b.bulk);
+        budgets_ = b;
+    }
+
+    /// @return The budgets currently in use.
+    [[nodiscard]] koru::priority_budgets priority_budgets() const noexcept
+    {
+        return budgets_;
+    }
+
+    /// @brief Interrupts run_until_notified(). Can be called from any thread. Requires AsyncIos.
+    void notify() noexcept requires AsyncIos
+    {
+        notified_.store(true, std::memory_order_release);
+        SetEvent(evs_[0]);
+    }
+
+    /// @brief Like run(), but keeps waiting after running out of work, only returning once notify() gets called. Requires AsyncIos.
+    /// @return The number of coroutines resumed.
+    std::size_t run_until_notified() requires AsyncIos
+    {
+        std::size_t n = 0;
+        while (!notified_.exchange(false, std::memory_order_acquire)) {
+            n += resume_ready();
+            const auto [sz, ready] = pending();
+            n += wait_one(sz, ready ? 0 : INFINITE) == wait_result::resumed;
+        }
+        return n;
+    }
+
+    /// @brief Responds to tracked I/O completions and scheduled coroutines by resuming the corresponding awaiting coroutine. Exits after running out of work.
+    /// @return The number of coroutines resumed.
+    std::size_t run()
+    {
+        for (std::size_t n = 0;;) {
+            n += resume_ready();
+            const auto [sz, ready] = pending();
+            if (sz == init_sz) {
+                if (ready)
+                    continue;
+                return n;
+            }
+            n += wait_one(sz, ready ? 0 : INFINITE) == wait_result::resumed;
+        }
+    }
+
+    /// @brief Resumes the coroutines whose I/Os have already completed or that have been scheduled. Never blocks.
+    /// @return The number of coroutines resumed.
+    std::size_t poll()
+    {
+        std::size_t n = resume_ready();
+        for (int sz; (sz = pending().sz) != init_sz;) {
+            const auto res = wait_one(sz, 0);
+            if (res == wait_result::timeout)
+                break;
+            n += res == wait_result::resumed;
+        }
+        return n;
+    }
+
+    /// @brief Blocks until a coroutine has been resumed or there is no more work.
+    /// @return The number of coroutines resumed; either 0 or 1.
+    std::size_t run_once()
+    {
+        for (;;) {
+            if (resume_ready(1))
+                return 1;
+            const auto [sz, ready] = pending();
+            if (sz == init_sz) {
+                if (ready)
+                    continue;
+                return 0;
+            }
+            if (wait_one(sz, ready ? 0 : INFINITE) == wait_result::resumed)
+                return 1;
+        }
+    }
+
+    /// @brief Like run(), but returns once the given time has elapsed. Completions that are already due are still responded to.
+    /// @param d The maximum duration to block for.
+    /// @return The number of coroutines resumed.
+    template <class Rep, class Period>
+    std::size_t run_for(const std::chrono::duration<Rep, Period> &d)
+    {
+        return run_until(std::chrono::steady_clock::now() + d);
+    }
+
+    /// @brief Like run(), but returns once the given point in time has been reached. Completions that are already due are still responded to.
+    /// @param tp The point in time after which to no longer block.
+    /// @return The number of coroutines resumed.
+    template <class Clock, class Duration>
+    std::size_t run_until(const std::chrono::time_point<Clock, Duration> &tp)
+    {
+        for (std::size_t n = 0;;) {
+            n += resume_ready();
+            const auto [sz, ready] = pending();
+            const auto ms          = timeout_until(tp);
+            if (sz == init_sz) {
+                if (ready && ms)
+                    continue;
+                return n;
+            }
+            const auto res = wait_one(sz, ready ? 0 : ms);
+            if (res == wait_result::timeout && !(ready && ms))
+                return n;
+            n += res == wait_result::resumed;
         }
     }
 
@@ -239,6 +1545,21 @@ class context
 
     detail::WSADATA wsadata;
 
+    koru::wait_policy policy_{};
+    koru::spin_stats spin_stats_{};
+
+    // Where the slots of each I/O class begin, the ones of the first class
+    // right after the notification event, and how many coros of each class
+    // got resumed since the budgets last started afresh
+    int begins_[nclasses]{init_sz, init_sz, init_sz};
+    koru::priority_budgets budgets_{};
+    uint32_t used_[nclasses]{};
+
+    detail::ready_node *ready_head_ = nullptr, *ready_tail_ = nullptr;
+
+    offload_limits offload_limits_{};
+    std::unique_ptr<detail::offload_pool> pool_;
+
     struct size_and_lock {
         detail::SRWLOCK srwl;
         int sz = init_sz;
@@ -250,8 +1571,19 @@ class context
         int sz = init_sz;
     };
     std::conditional_t<AtomicIos, size_and_lock, size> last_;
+
+    std::conditional_t<AsyncIos, std::atomic<bool>, detail::empty> notified_{};
 #pragma warning(suppress : 4820) /* padding added after data member */
 };
+
+/// @brief Suspends the awaiting coroutine to be resumed by the thread running the given context.
+/// @param ctx The context to hop onto; see context::schedule().
+/// @return Task object representing the scheduling; must be awaited on immediately.
+template <class Ctx>
+[[nodiscard]] KORU_inline auto resume_on(Ctx &ctx) noexcept
+{
+    return ctx.schedule();
+}
 } // namespace koru
 
 #include "detail/win_macros_end.inl"
\ No newline at end of file
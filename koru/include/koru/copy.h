@@ -0,0 +1,177 @@
+//
+// COPY : File copying keeping many chunk reads and writes in flight
+//
+
+#pragma once
+
+#include "context.h"
+#include "sync_task.h"
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace koru
+{
+/// @brief The tunables of copy().
+struct copy_options {
+    /// The size in bytes of the chunks read and written at once.
+    uint32_t chunk_size = 1 << 20;
+    /// The number of chunks in flight at once, each with a buffer of its own; clamped to the capacity of the context.
+    uint32_t depth = 8;
+    /// Whether to try sharing the blocks of the source with the destination first, where the file system supports it.
+    bool clone = true;
+    /// Whether to skip the unallocated ranges of the source, making the destination sparse if there are any.
+    bool sparse = true;
+    /// Called after each chunk with the number of bytes copied so far and the total number of bytes to copy.
+    std::function<void(uint64_t, uint64_t)> progress;
+};
+
+namespace detail
+{
+void set_size(HANDLE h, uint64_t size);
+void set_sparse(HANDLE h);
+/// @brief Clones the blocks of a file of the given size onto another.
+/// @return Whether cloning is supported between the files and succeeded.
+bool clone_file(HANDLE src, HANDLE dst, uint64_t size);
+/// @brief Queries the allocated ranges of a file, from the given offset up to the given size.
+/// @return The number of ranges stored; if n, there may be more past the last.
+std::size_t allocated_ranges(HANDLE h, uint64_t offset, uint64_t size,
+                             byte_range *out, std::size_t n);
+
+// The work shared by the chunk copiers of a copy
+struct copy_state {
+    std::vector<byte_range> ranges;
+    std::size_t next = 0;
+    uint64_t cursor  = 0;
+    uint64_t done    = 0, total;
+    bool failed      = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
+inline std::vector<byte_range> all_allocated_ranges(const HANDLE h,
+                                                    const uint64_t size)
+{
+    std::vector<byte_range> res;
+    byte_range buf[64];
+    for (uint64_t off = 0; off < size;) {
+        const auto n = allocated_ranges(h, off, size, buf, std::size(buf));
+        res.insert(res.end(), buf, buf + n);
+        if (n < std::size(buf))
+            break;
+        off = buf[n - 1].offset + buf[n - 1].length;
+    }
+    return res;
+}
+
+template <class Ctx>
+sync_task<void> copy_chunks(Ctx &ctx, const file &src, const file &dst,
+                            copy_state &st, const copy_options &opts,
+                            char *const buf)
+{
+    while (!st.failed) {
+        // Claim the next chunk
+        while (st.next < st.ranges.size() &&
+               st.cursor >= st.ranges[st.next].length) {
+            ++st.next;
+            st.cursor = 0;
+        }
+        if (st.next == st.ranges.size())
+            co_return;
+        const auto off = st.ranges[st.next].offset + st.cursor;
+        const auto n   = static_cast<uint32_t>(std::min<uint64_t>(
+            opts.chunk_size, st.ranges[st.next].length - st.cursor));
+        st.cursor += n;
+
+        try {
+            // Reads may come short; the source mustn't shrink though, or
+            // the rest of the chunk would be left zeroed
+            for (uint32_t got = 0; got < n;) {
+                const auto read = co_await ctx.read(src.at(off + got),
+                                                    buf + got, n - got);
+                if (!read) [[unlikely]]
+                    throw std::system_error{
+                        std::make_error_code(std::errc::io_error)};
+                got += static_cast<uint32_t>(read);
+            }
+            for (uint32_t w = 0; w < n;) {
+                const auto written =
+                    co_await ctx.write(dst.at(off + w), buf + w, n - w);
+                if (!written) [[unlikely]]
+                    throw std::system_error{std::make_error_code(
+                        std::errc::no_space_on_device)};
+                w += static_cast<uint32_t>(written);
+            }
+        } catch (...) {
+            st.failed = true;
+            throw;
+        }
+        st.done += n;
+        if (opts.progress)
+            opts.progress(st.done, st.total);
+    }
+}
+} // namespace detail
+
+/// @brief Copies the contents of a file onto another, truncating or extending the latter to the size of the former.
+/// @param ctx The context operating on the files.
+/// @param src A file opened by ctx with read access; must outlive the copy.
+/// @param dst A file opened by ctx with read and write access; must outlive the copy.
+/// @param opts The tunables of the copy.
+/// @return Task object resulting in the size of the copied file.
+template <class Ctx>
+sync_task<uint64_t> copy(Ctx &ctx, const detail::file &src,
+                         const detail::file &dst, copy_options opts = {})
+{
+    const auto hsrc = src.native_handle, hdst = dst.native_handle;
+    const file_stat fs = co_await ctx.stat(src);
+    const auto fsize   = fs.size;
+    if (opts.clone && co_await ctx.offload([=] {
+            return detail::clone_file(hsrc, hdst, fsize);
+        })) {
+        if (opts.progress)
+            opts.progress(fsize, fsize);
+        co_return fsize;
+    }
+
+    detail::copy_state st{.total = fsize};
+    if (opts.sparse) {
+        st.ranges = co_await ctx.offload(
+            [=] { return detail::all_allocated_ranges(hsrc, fsize); });
+        st.total = 0;
+        for (const auto &r : st.ranges)
+            st.total += r.length;
+        if (st.total < fsize)
+            co_await ctx.offload([=] { detail::set_sparse(hdst); });
+    } else {
+        st.ranges.push_back({0, fsize});
+    }
+    co_await ctx.offload([=] { detail::set_size(hdst, fsize); });
+
+    const auto depth = std::clamp<std::size_t>(opts.depth, 1, Ctx::capacity);
+    const auto ring =
+        std::make_unique_for_overwrite<char[]>(depth * opts.chunk_size);
+    std::vector<std::unique_ptr<sync_task<void>>> copiers;
+    copiers.reserve(depth);
+    for (std::size_t i = 0; i < depth; ++i)
+        copiers.emplace_back(new sync_task<void>(detail::copy_chunks(
+            ctx, src, dst, st, opts, ring.get() + i * opts.chunk_size)));
+
+    std::exception_ptr ep;
+    for (const auto &c : copiers) {
+        try {
+            auto &t = *c;
+            co_await t;
+        } catch (...) {
+            if (!ep)
+                ep = std::current_exception();
+        }
+    }
+    if (ep)
+        std::rethrow_exception(ep);
+    co_return fsize;
+}
+} // namespace koru
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "utils.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace koru::detail
+{
+
+//
+// FRAME POOL : Per-thread free lists recycling coroutine frames
+//
+
+/// @brief Recycles the frames of coroutines, so that a coroutine started on a thread that has run one of a similar size before takes no heap allocation. Frames are kept in per-thread free lists by size class; a frame freed on another thread than the one that allocated it joins the lists of the freeing thread. Each list holds a bounded number of frames, the surplus going back to the heap, as does everything once the thread exits.
+class frame_pool
+{
+    static constexpr std::size_t granularity = 64; // Of the size classes
+    static constexpr std::size_t nclasses    = 1024 / granularity + 1;
+    static constexpr uint32_t max_free       = 64; // Per size class
+
+    struct block {
+        block *next;
+    };
+
+    // Trivially destructible, so that it outlives the thread's destructors
+    struct free_lists {
+        block *heads[nclasses];
+        uint32_t counts[nclasses];
+        bool closed; // Once the thread's exiting
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+    struct drainer {
+        ~drainer()
+        {
+            for (auto &head : lists_.heads)
+                while (const auto b = head) {
+                    head = b->next;
+                    ::operator delete(b);
+                }
+            lists_.closed = true;
+        }
+    };
+
+    static constexpr std::size_t size_class(const std::size_t n) noexcept
+    {
+        return (n + granularity - 1) / granularity;
+    }
+
+  public:
+    /// @return Room for a frame of the given size.
+    static void *allocate(const std::size_t n)
+    {
+        const auto k = size_class(n);
+        if (k >= nclasses)
+            return ::operator new(n);
+        if (const auto b = lists_.heads[k]) {
+            lists_.heads[k] = b->next;
+            --lists_.counts[k];
+            return b;
+        }
+        return ::operator new(k * granularity);
+    }
+
+    /// @brief Frees room returned by allocate().
+    /// @param n The size allocate() got called with.
+    static void deallocate(void *const p, const std::size_t n) noexcept
+    {
+        if (const auto k = size_class(n);
+            k < nclasses && lists_.counts[k] < max_free && !lists_.closed) {
+            // Drains the lists once the thread exits
+            static thread_local const drainer d;
+            lists_.heads[k] = ::new (p) block{lists_.heads[k]};
+            ++lists_.counts[k];
+            return;
+        }
+        ::operator delete(p);
+    }
+
+  private:
+    static inline thread_local free_lists lists_{};
+};
+} // namespace koru::detail
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "winapi.h"
 #include <exception>
 #include <stdexcept>
+#include <system_error>
 #include <type_traits>
 
 namespace koru::detail
@@ -80,6 +81,8 @@ constexpr inline struct {
 
 [[noreturn]] void throw_last_winapi_error();
 [[noreturn]] void throw_last_wsa_error();
+std::error_code winapi_error(DWORD code) noexcept;
+std::error_code wsa_error(int code) noexcept;
 
 template <class T, class F, class... Args>
 constexpr KORU_inline T &or_(T &val, F &&f, Args &&...args) noexcept(
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../context.h"
+#include "utils.h"
+#include "winapi.h"
+#include <utility>
+
+namespace koru::detail
+{
+
+//
+// WAITERS : Coroutines suspended on a synchronization primitive
+//
+
+/// @brief An SRWLOCK initialized upon construction, for primitives usable from several threads at once to derive from.
+struct lockable {
+    SRWLOCK srwl;
+    KORU_inline KORU_defctor(lockable, noexcept { InitializeSRWLock(&srwl); });
+};
+
+/// @brief A coroutine suspended on a synchronization primitive. It's resumed by the context it awaited through, which may run on another thread than the one waking it. Lives in the frame of the suspended coroutine.
+struct waiter : ready_node {
+    waiter *link;
+    void (*post)(void *ctx, ready_node &n) noexcept;
+    void *ctx;
+
+    template <class Ctx>
+    KORU_inline explicit waiter(Ctx &c) noexcept
+        : ready_node{}, link{nullptr}, post{&post_to<Ctx>}, ctx{&c}
+    {
+    }
+    KORU_defctor(waiter, = delete;);
+
+    /// @brief Schedules the coroutine onto its context. Must be called with no lock held that the coroutine may take once resumed.
+    void wake() noexcept { post(ctx, *this); }
+
+  private:
+    template <class Ctx>
+    static void post_to(void *const ctx, ready_node &n) noexcept
+    {
+        static_cast<Ctx *>(ctx)->post(n);
+    }
+};
+
+/// @brief An intrusive FIFO queue of waiters.
+class waiter_queue
+{
+  public:
+    [[nodiscard]] constexpr bool empty() const noexcept { return !head_; }
+
+    void push(waiter &w) noexcept
+    {
+        w.link                        = nullptr;
+        (tail_ ? tail_->link : head_) = &w;
+        tail_                         = &w;
+    }
+
+    /// @return The longest waiting waiter, or nullptr if there's none.
+    waiter *pop() noexcept
+    {
+        const auto w = head_;
+        if (w && !(head_ = w->link))
+            tail_ = nullptr;
+        return w;
+    }
+
+    /// @brief Empties *this.
+    /// @return The former head, linking the former waiters through waiter::link.
+    waiter *take_all() noexcept
+    {
+        tail_ = nullptr;
+        return std::exchange(head_, nullptr);
+    }
+
+  private:
+    waiter *head_ = nullptr, *tail_ = nullptr;
+};
+
+/// @brief Wakes a list of waiters as returned by waiter_queue::take_all().
+inline void wake_all(waiter *w) noexcept
+{
+    while (w) {
+        // The resumed coroutine may destroy the waiter
+        const auto next = w->link;
+        w->wake();
+        w = next;
+    }
+}
+} // namespace koru::detail
\ No newline at end of file
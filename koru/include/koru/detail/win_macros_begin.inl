@@ -1,9 +1,12 @@
 #pragma push_macro("INFINITE")
 #pragma push_macro("ERROR_IO_PENDING")
+#pragma push_macro("ERROR_HANDLE_EOF")
 #pragma push_macro("GENERIC_READ")
 #pragma push_macro("GENERIC_WRITE")
 #pragma push_macro("FILE_FLAG_OVERLAPPED")
 #pragma push_macro("FILE_ATTRIBUTE_NORMAL")
+#pragma push_macro("FILE_ATTRIBUTE_DIRECTORY")
+#pragma push_macro("FILE_ATTRIBUTE_REPARSE_POINT")
 #pragma push_macro("FILE_SHARE_READ")
 #pragma push_macro("FILE_SHARE_WRITE")
 #pragma push_macro("FILE_SHARE_DELETE")
@@ -16,6 +19,7 @@
 #pragma push_macro("INVALID_HANDLE_VALUE")
 #pragma push_macro("STATUS_WAIT_0")
 #pragma push_macro("WAIT_OBJECT_0")
+#pragma push_macro("WAIT_TIMEOUT")
 #pragma push_macro("AF_UNSPEC")
 #pragma push_macro("AF_INET")
 #pragma push_macro("AF_INET6")
@@ -23,6 +27,11 @@
 #pragma push_macro("SOCK_DGRAM")
 #pragma push_macro("IPPROTO_TCP")
 #pragma push_macro("IPPROTO_UDP")
+#pragma push_macro("AI_PASSIVE")
+#pragma push_macro("WSAENOBUFS")
+#pragma push_macro("WSAECONNRESET")
+#pragma push_macro("WSAEMSGSIZE")
+#pragma push_macro("INVALID_SOCKET")
 #pragma push_macro("WSADESCRIPTION_LEN")
 #pragma push_macro("WSASYS_STATUS_LEN")
 #pragma push_macro("MAKEWORD")
@@ -30,10 +39,13 @@
 #pragma warning(disable : 4005) /* macro redefinition */
 #define INFINITE 0xFFFFFFFF     // Infinite timeout
 #define ERROR_IO_PENDING 997L   // dderror
+#define ERROR_HANDLE_EOF 38L
 #define GENERIC_READ (0x80000000L)
 #define GENERIC_WRITE (0x40000000L)
 #define FILE_FLAG_OVERLAPPED 0x40000000
 #define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define FILE_ATTRIBUTE_DIRECTORY 0x00000010
+#define FILE_ATTRIBUTE_REPARSE_POINT 0x00000400
 #define FILE_SHARE_READ 0x00000001
 #define FILE_SHARE_WRITE 0x00000002
 #define FILE_SHARE_DELETE 0x00000004
@@ -47,6 +59,7 @@
     ((::koru::detail::HANDLE)(::koru::detail::LONG_PTR)-1)
 #define STATUS_WAIT_0 ((::koru::detail::DWORD)0x00000000L)
 #define WAIT_OBJECT_0 ((STATUS_WAIT_0) + 0)
+#define WAIT_TIMEOUT 258L // dderror
 #define AF_UNSPEC 0    // unspecified
 #define AF_INET 2      // internetwork: UDP, TCP, etc.
 #define AF_INET6 23    // Internetwork Version 6
@@ -54,6 +67,11 @@
 #define SOCK_DGRAM 2   /* datagram socket */
 #define IPPROTO_TCP 6  /* tcp */
 #define IPPROTO_UDP 17 /* user datagram protocol */
+#define AI_PASSIVE 0x00000001 // Socket address will be used in bind() call
+#define WSAENOBUFS 10055L
+#define WSAECONNRESET 10054L
+#define WSAEMSGSIZE 10040L
+#define INVALID_SOCKET (::koru::detail::SOCKET)(~0)
 #define WSADESCRIPTION_LEN 256
 #define WSASYS_STATUS_LEN 128
 #define MAKEWORD(low, high)                                                    \
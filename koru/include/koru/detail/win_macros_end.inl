@@ -1,9 +1,12 @@
 #pragma pop_macro("INFINITE")
 #pragma pop_macro("ERROR_IO_PENDING")
+#pragma pop_macro("ERROR_HANDLE_EOF")
 #pragma pop_macro("GENERIC_READ")
 #pragma pop_macro("GENERIC_WRITE")
 #pragma pop_macro("FILE_FLAG_OVERLAPPED")
 #pragma pop_macro("FILE_ATTRIBUTE_NORMAL")
+#pragma pop_macro("FILE_ATTRIBUTE_DIRECTORY")
+#pragma pop_macro("FILE_ATTRIBUTE_REPARSE_POINT")
 #pragma pop_macro("FILE_SHARE_READ")
 #pragma pop_macro("FILE_SHARE_WRITE")
 #pragma pop_macro("FILE_SHARE_DELETE")
@@ -16,6 +19,7 @@
 #pragma pop_macro("INVALID_HANDLE_VALUE")
 #pragma pop_macro("STATUS_WAIT_0")
 #pragma pop_macro("WAIT_OBJECT_0")
+#pragma pop_macro("WAIT_TIMEOUT")
 #pragma pop_macro("AF_UNSPEC")
 #pragma pop_macro("AF_INET")
 #pragma pop_macro("AF_INET6")
@@ -23,6 +27,11 @@
 #pragma pop_macro("SOCK_DGRAM")
 #pragma pop_macro("IPPROTO_TCP")
 #pragma pop_macro("IPPROTO_UDP")
+#pragma pop_macro("AI_PASSIVE")
+#pragma pop_macro("WSAENOBUFS")
+#pragma pop_macro("WSAECONNRESET")
+#pragma pop_macro("WSAEMSGSIZE")
+#pragma pop_macro("INVALID_SOCKET")
 #pragma pop_macro("WSADESCRIPTION_LEN")
 #pragma pop_macro("WSASYS_STATUS_LEN")
 #pragma pop_macro("MAKEWORD")
\ No newline at end of file
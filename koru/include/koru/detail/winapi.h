@@ -23,12 +23,14 @@ using LONG_PTR  = intptr_t;
 using BYTE      = unsigned char;
 using WORD      = unsigned short;
 using DWORD     = unsigned long;
+using ULONG     = unsigned long;
 using LPDWORD   = DWORD *;
 using PVOID     = void *;
 using LPVOID    = void *;
 using LPCVOID   = const void *;
 using HANDLE    = void *;
 using BOOL      = int;
+using CHAR      = char;
 using WCHAR     = wchar_t;
 using PWSTR     = WCHAR *;
 using LPWSTR    = WCHAR *;
@@ -82,6 +84,12 @@ struct WSADATA {
 #pragma warning(suppress : 4820) /* padding added after data member */
 };
 
+struct WSABUF {
+    ULONG len;
+#pragma warning(suppress : 4820) /* padding added after data member */
+    CHAR *buf;
+};
+
 struct ADDRINFOW {
     int ai_flags;             // AI_PASSIVE, AI_CANONNAME, AI_NUMERICHOST
     int ai_family;            // PF_xxx
@@ -117,6 +125,22 @@ HANDLE CreateFileW(LPCWSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
                    DWORD dwCreationDisposition, DWORD dwFlagsAndAttributes,
                    HANDLE hTemplateFile) noexcept;
 int WSAStartup(WORD wVersionRequested, WSADATA *lpWSAData) noexcept;
+int WSARecv(SOCKET s, WSABUF *lpBuffers, DWORD dwBufferCount,
+            LPDWORD lpNumberOfBytesRecvd, LPDWORD lpFlags,
+            koru::detail::OVERLAPPED *lpOverlapped) noexcept;
+int WSASend(SOCKET s, WSABUF *lpBuffers, DWORD dwBufferCount,
+            LPDWORD lpNumberOfBytesSent, DWORD dwFlags,
+            koru::detail::OVERLAPPED *lpOverlapped) noexcept;
+BOOL AcceptEx(SOCKET sListenSocket, SOCKET sAcceptSocket,
+              PVOID lpOutputBuffer, DWORD dwReceiveDataLength,
+              DWORD dwLocalAddressLength, DWORD dwRemoteAddressLength,
+              LPDWORD lpdwBytesReceived,
+              koru::detail::OVERLAPPED *lpOverlapped) noexcept;
+// Takes the address untyped, as struct sockaddr may belong to either namespace
+BOOL ConnectEx(SOCKET s, const void *name, int namelen,
+               PVOID lpSendBuffer, DWORD dwSendDataLength,
+               LPDWORD lpdwBytesSent,
+               koru::detail::OVERLAPPED *lpOverlapped) noexcept;
 } // namespace koru::detail
 
 extern "C" {
@@ -126,7 +150,9 @@ koru::detail::DWORD KORU_winapi WaitForMultipleObjects(
 koru::detail::DWORD KORU_winapi GetLastError(void);
 koru::detail::BOOL KORU_winapi CloseHandle(koru::detail::HANDLE hObject);
 koru::detail::BOOL KORU_winapi SetEvent(koru::detail::HANDLE hEvent);
+koru::detail::BOOL KORU_winapi ResetEvent(koru::detail::HANDLE hEvent);
 int KORU_wsaapi WSACleanup(void);
+int KORU_wsaapi WSAGetLastError(void);
 int KORU_wsaapi closesocket(koru::detail::SOCKET s);
 }
 
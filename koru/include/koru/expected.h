@@ -0,0 +1,98 @@
+//
+// EXPECTED : Result or error code of an operation reporting failure as a value
+//
+
+#pragma once
+
+#include "detail/utils.h"
+#include <system_error>
+#include <type_traits>
+#include <version>
+
+#ifdef __cpp_lib_expected
+#include <expected>
+#endif
+
+namespace koru
+{
+#ifdef __cpp_lib_expected
+using std::expected;
+using std::unexpected;
+#else
+/// @brief Wraps an error for constructing an expected from; a fallback for std::unexpected until C++23.
+template <class E>
+class unexpected
+{
+  public:
+    constexpr explicit unexpected(const E &e) noexcept : e_{e} {}
+
+    [[nodiscard]] constexpr const E &error() const noexcept { return e_; }
+
+  private:
+    E e_;
+};
+
+/// @brief Holds either a value or the error that prevented it; a fallback for std::expected until C++23, covering the trivially copyable results of koru's operations.
+/// @tparam T The type of the value.
+/// @tparam E The type of the error.
+template <class T, class E>
+class expected
+{
+    static_assert(std::is_trivially_copyable_v<T> &&
+                      std::is_trivially_copyable_v<E>,
+                  "the expected fallback only holds trivially copyable types");
+
+  public:
+    using value_type = T;
+    using error_type = E;
+
+    constexpr expected(const T &v) noexcept : v_{v}, ok_{true} {}
+    template <class G>
+    constexpr expected(const unexpected<G> &u) noexcept
+        : e_{u.error()}, ok_{false}
+    {
+    }
+
+    [[nodiscard]] constexpr bool has_value() const noexcept { return ok_; }
+    constexpr explicit operator bool() const noexcept { return ok_; }
+
+    [[nodiscard]] constexpr const T &operator*() const noexcept
+    {
+        KORU_assert(ok_);
+        return v_;
+    }
+    [[nodiscard]] constexpr const T *operator->() const noexcept
+    {
+        KORU_assert(ok_);
+        return &v_;
+    }
+
+    /// @return The value; throws std::system_error if there's none, which std::expected signals with std::bad_expected_access instead.
+    [[nodiscard]] constexpr const T &value() const
+    {
+        if (!ok_) [[unlikely]]
+            throw std::system_error{e_};
+        return v_;
+    }
+    template <class U>
+    [[nodiscard]] constexpr T value_or(U &&u) const
+    {
+        return ok_ ? v_ : static_cast<T>(static_cast<U &&>(u));
+    }
+
+    [[nodiscard]] constexpr const E &error() const noexcept
+    {
+        KORU_assert(!ok_);
+        return e_;
+    }
+
+  private:
+    union {
+        T v_;
+        E e_;
+    };
+    bool ok_;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+#endif
+} // namespace koru
\ No newline at end of file
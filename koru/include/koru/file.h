@@ -5,6 +5,7 @@
 #pragma once
 
 #include "detail/winapi.h"
+#include <string>
 
 #include "detail/win_macros_begin.inl"
 
@@ -12,6 +13,16 @@ namespace koru
 {
 template <bool, bool, std::size_t>
 class context;
+
+/// @brief The class of an I/O, which decides how soon a context resumes the coroutine awaiting it once several have completed.
+enum class io_priority : unsigned char {
+    /// Latency-sensitive I/Os, e.g., the ones a user waits on.
+    interactive,
+    normal,
+    /// Throughput-bound I/Os, e.g., copies or scans, which may wait.
+    bulk
+};
+
 namespace detail
 {
 class file
@@ -19,20 +30,24 @@ class file
     template <bool, bool, std::size_t>
     friend class context;
 
+    constexpr file(HANDLE handle) noexcept : native_handle(handle) {}
+
+  public:
+    /// @brief A byte offset into a file, as taken by read and write operations.
     struct location {
         uint64_t offset;
         HANDLE handle;
+        io_priority priority = io_priority::normal;
 #pragma warning(suppress : 4820) /* padding added after data member */
     };
 
-    constexpr file(HANDLE handle) noexcept : native_handle(handle) {}
-
-  public:
     KORU_defctor(file, = delete;);
     ~file()
     {
-        [[maybe_unused]] const auto res = CloseHandle(native_handle);
-        KORU_assert(res != 0);
+        if (owned_) {
+            [[maybe_unused]] const auto res = CloseHandle(native_handle);
+            KORU_assert(res != 0);
+        }
     }
 
     /// @brief A convenience function to facilitate specifying file-location info in read/write operations.
@@ -40,14 +55,66 @@ class file
     /// @return The coupling of the file handle and given byte offset.
     [[nodiscard]] constexpr location at(uint64_t offset) const noexcept
     {
-        return {offset, native_handle};
+        return {offset, native_handle, priority_};
+    }
+
+    /// @return The class of the I/Os on *this, as set by context::set_io_priority().
+    [[nodiscard]] constexpr io_priority priority() const noexcept
+    {
+        return priority_;
     }
 
     /// @brief This is the WinAPI handle representing the file.
     const HANDLE native_handle;
+
+  private:
+    bool owned_           = true;
+    io_priority priority_ = io_priority::normal;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
+/// @brief A span of bytes within a file.
+struct byte_range {
+    uint64_t offset;
+    uint64_t length;
 };
 } // namespace detail
 
+/// @brief The metadata of a file.
+struct file_stat {
+    /// The size of the file in bytes.
+    uint64_t size;
+    /// The time of the last write as a FILETIME-conformant tick count.
+    uint64_t last_write_time;
+    /// An identifier unique to the file within its volume.
+    uint64_t file_id;
+    /// The serial number of the volume the file resides on.
+    uint32_t volume_serial;
+    /// The number of hard links to the file.
+    uint32_t links;
+    /// The FILE_ATTRIBUTE_* flags of the file.
+    uint32_t attributes;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
+/// @brief An entry of a directory, as found by scan_dir().
+struct dir_entry {
+    /// The path of the entry: the scanned root joined with the names leading to the entry.
+    std::wstring path;
+    /// The size of the file in bytes.
+    uint64_t size;
+    /// The time of the last write as a FILETIME-conformant tick count.
+    uint64_t last_write_time;
+    /// The FILE_ATTRIBUTE_* flags of the entry.
+    uint32_t attributes;
+
+    [[nodiscard]] constexpr bool is_directory() const noexcept
+    {
+        return attributes & FILE_ATTRIBUTE_DIRECTORY;
+    }
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
 enum class access : detail::DWORD {
     read       = GENERIC_READ,
     write      = GENERIC_WRITE,
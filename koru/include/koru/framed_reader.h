@@ -0,0 +1,247 @@
+//
+// FRAMED READER : Frames of a byte stream viewed where they got read into
+//
+
+#pragma once
+
+#include "async_generator.h"
+#include "context.h"
+#include "file.h"
+#include "socket.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace koru
+{
+namespace detail
+{
+/// @return The first occurrence of a byte in [p, end), or end if there's none; compares 16 bytes at a time where SSE2 is available.
+inline const std::byte *find_byte(const std::byte *p,
+                                  const std::byte *const end,
+                                  const std::byte b) noexcept
+{
+#if defined(_M_X64) || defined(__SSE2__)
+    const auto needle = _mm_set1_epi8(static_cast<char>(b));
+    for (; end - p >= 16; p += 16) {
+        const auto chunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        if (const auto mask = static_cast<unsigned>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle))))
+            return p + std::countr_zero(mask);
+    }
+#endif
+    for (; p != end; ++p)
+        if (*p == b)
+            return p;
+    return end;
+}
+
+inline std::system_error bad_frame(const std::errc e)
+{
+    return std::system_error{std::make_error_code(e)};
+}
+} // namespace detail
+
+/// @brief Where a frame lies within the buffered bytes of a stream, as found by a codec.
+struct frame_bounds {
+    std::size_t offset = 0; // Of the payload, past the header
+    std::size_t size   = 0; // Of the payload
+    std::size_t total  = 0; // Of the frame; 0 if it can't be told yet
+};
+
+/// @brief Frames prefixed with their payload size as an unsigned LEB128 varint, as protobuf delimits messages.
+struct varint_codec {
+    /// @param data The buffered bytes, starting with a frame.
+    /// @return The bounds of the frame, whose total may exceed data once its header has arrived; throws std::errc::bad_message on a malformed header.
+    frame_bounds decode(const std::span<const std::byte> data) const
+    {
+        uint64_t size = 0;
+        for (std::size_t i = 0; i < data.size() && i < 5; ++i) {
+            const auto b = std::to_integer<uint64_t>(data[i]);
+            size |= (b & 0x7f) << (7 * i);
+            if (!(b & 0x80)) {
+                // Frames can't be larger than the reader's buffer anyway
+                if (size > UINT32_MAX)
+                    throw detail::bad_frame(std::errc::message_size);
+                return {i + 1, size, i + 1 + size};
+            }
+        }
+        if (data.size() >= 5)
+            throw detail::bad_frame(std::errc::bad_message);
+        return {};
+    }
+};
+
+/// @brief Frames prefixed with their payload size as a big-endian integer.
+/// @tparam Width The size of the prefix in bytes: 1, 2 or 4.
+template <std::size_t Width>
+struct fixed_codec {
+    static_assert(Width == 1 || Width == 2 || Width == 4);
+
+    /// @param data The buffered bytes, starting with a frame.
+    /// @return The bounds of the frame, whose total may exceed data once its header has arrived.
+    frame_bounds decode(const std::span<const std::byte> data) const noexcept
+    {
+        if (data.size() < Width)
+            return {};
+        std::size_t size = 0;
+        for (std::size_t i = 0; i < Width; ++i)
+            size = size << 8 | std::to_integer<std::size_t>(data[i]);
+        return {Width, size, Width + size};
+    }
+};
+
+/// @brief Frames terminated by a delimiter byte, e.g., the lines of a text protocol. Remembers how far the frame being read has been searched, so that each byte gets looked at once however many reads it takes the frame to arrive.
+class delimiter_codec
+{
+  public:
+    /// @brief Splits lines ending with '\n'.
+    constexpr delimiter_codec() noexcept = default;
+    /// @param delim The byte ending each frame, which isn't part of the payload.
+    constexpr explicit delimiter_codec(const std::byte delim) noexcept
+        : delim_{delim}
+    {
+    }
+
+    /// @param data The buffered bytes, starting with a frame.
+    /// @return The bounds of the frame, whose total is 0 until its delimiter has arrived.
+    frame_bounds decode(const std::span<const std::byte> data) noexcept
+    {
+        const auto end = data.data() + data.size();
+        const auto p = detail::find_byte(data.data() + scanned_, end, delim_);
+        if (p == end) {
+            scanned_ = data.size();
+            return {};
+        }
+        scanned_        = 0;
+        const auto size = static_cast<std::size_t>(p - data.data());
+        return {0, size, size + 1};
+    }
+
+  private:
+    std::size_t scanned_ = 0; // Bytes of the pending frame with no delimiter
+    std::byte delim_{'\n'};
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
+/// @brief The tunables of a framed_reader.
+struct framed_reader_options {
+    /// The initial size of the buffer, which reads get as much of as is free.
+    uint32_t buffer_size = 64 * 1024;
+    /// The size of the largest frame, up to which the buffer grows to hold a frame whole.
+    uint32_t max_frame_size = 16 * 1024 * 1024;
+};
+
+/// @brief Splits the bytes read from a socket or file into frames, yielding a view of each frame's payload within its buffer rather than a copy. Reads only once the buffered bytes hold no whole frame, and moves the bytes of an incomplete frame to the front of the buffer only once the frame wouldn't fit otherwise, so that each frame stays contiguous.
+/// @tparam Ctx The type of the context reading the stream.
+/// @tparam Source detail::socket or detail::file.
+/// @tparam Codec The type that finds frames in the buffered bytes: a varint_codec, fixed_codec or delimiter_codec, or any type with a member function decode() like theirs.
+template <class Ctx, class Source, class Codec>
+class framed_reader
+{
+    static_assert(std::is_same_v<Source, detail::socket> ||
+                  std::is_same_v<Source, detail::file>);
+
+  public:
+    /// @param ctx The context that created src.
+    /// @param src The stream socket or file to read; must outlive *this. Files are read from their start.
+    /// @param codec The codec to find frames with.
+    /// @param opts The tunables of *this.
+    [[nodiscard]] framed_reader(Ctx &ctx, const Source &src, Codec codec = {},
+                                const framed_reader_options opts = {})
+        : ctx_{ctx}, src_{src}, codec_{std::move(codec)}, opts_{opts},
+          buf_{std::make_unique_for_overwrite<std::byte[]>(opts.buffer_size)},
+          cap_{opts.buffer_size}, gen_{frames()}
+    {
+        KORU_assert(opts_.buffer_size &&
+                    opts_.buffer_size <= opts_.max_frame_size);
+    }
+    KORU_defctor(framed_reader, = delete;);
+
+    /// @brief Reads until the next frame is whole, unless it's already buffered.
+    /// @return Task object resulting in a pointer to the payload of the frame, valid until the next call, or nullptr at the end of the stream. Throws the errors of reading, std::errc::message_size on a frame larger than max_frame_size, and std::errc::bad_message on a malformed frame or a stream ending mid-frame. Must be awaited on immediately.
+    [[nodiscard]] KORU_inline auto next() noexcept { return gen_.next(); }
+
+  private:
+    auto read_some(std::byte *const p, const uint32_t nbytes)
+    {
+        if constexpr (std::is_same_v<Source, detail::socket>)
+            return ctx_.recv(src_, p, nbytes);
+        else
+            return ctx_.read(src_.at(offset_), p, nbytes);
+    }
+
+    /// @brief Makes room behind the buffered bytes for a frame of the given total size, or for at least one more byte if it's unknown.
+    void make_room(const std::size_t total)
+    {
+        const auto pending = end_ - begin_;
+        const auto want    = std::max(total, pending + 1);
+        if (want > opts_.max_frame_size) [[unlikely]]
+            throw detail::bad_frame(std::errc::message_size);
+        if (begin_ + want <= cap_)
+            return;
+        if (want > cap_) {
+            const auto cap =
+                std::max(want, std::min<std::size_t>(cap_ * 2,
+                                                     opts_.max_frame_size));
+            auto buf = std::make_unique_for_overwrite<std::byte[]>(cap);
+            std::memcpy(buf.get(), buf_.get() + begin_, pending);
+            buf_ = std::move(buf);
+            cap_ = cap;
+        } else {
+            std::memmove(buf_.get(), buf_.get() + begin_, pending);
+        }
+        begin_ = 0;
+        end_   = pending;
+    }
+
+    async_generator<const std::span<const std::byte>> frames()
+    {
+        for (bool eof = false;;) {
+            const std::span<const std::byte> data{buf_.get() + begin_,
+                                                  end_ - begin_};
+            const auto f = codec_.decode(data);
+            if (f.total && f.total <= data.size()) {
+                begin_ += f.total;
+                co_yield data.subspan(f.offset, f.size);
+                continue;
+            }
+            if (eof) {
+                if (!data.empty()) [[unlikely]]
+                    throw detail::bad_frame(std::errc::bad_message);
+                co_return;
+            }
+
+            if (begin_ == end_)
+                begin_ = end_ = 0;
+            make_room(f.total);
+            const auto n = co_await read_some(
+                buf_.get() + end_, static_cast<uint32_t>(cap_ - end_));
+            end_ += n;
+            offset_ += n;
+            eof = !n;
+        }
+    }
+
+    Ctx &ctx_;
+    const Source &src_;
+    Codec codec_;
+    framed_reader_options opts_;
+    std::unique_ptr<std::byte[]> buf_;
+    std::size_t cap_, begin_ = 0, end_ = 0;
+    uint64_t offset_ = 0; // Of the next read into a file
+    async_generator<const std::span<const std::byte>> gen_;
+};
+} // namespace koru
\ No newline at end of file
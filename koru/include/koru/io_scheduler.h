@@ -0,0 +1,224 @@
+//
+// I/O SCHEDULER : Submission stage sorting and merging reads before issue
+//
+
+#pragma once
+
+#include "context.h"
+#include "sync_task.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace koru
+{
+/// @brief The tunables of an io_scheduler.
+struct io_scheduler_options {
+    /// How long to hold reads back for more to arrive. With a zero window, the reads submitted before the run loop of the context looks for work again are gathered.
+    std::chrono::milliseconds window{0};
+    /// The greatest number of bytes between two reads for them to still get merged; the bytes in between are read and discarded.
+    uint32_t max_gap = 4096;
+    /// The greatest size in bytes of a merged read.
+    uint32_t max_read = 1 << 20;
+};
+
+/// @brief Counters describing the effect of an io_scheduler.
+struct io_scheduler_stats {
+    /// The number of reads submitted to the scheduler.
+    std::size_t requests;
+    /// The number of reads the scheduler submitted to the context.
+    std::size_t reads;
+};
+
+/// @brief Holds reads back for a short window, then sorts them per file by offset and merges neighbouring ones into larger reads, whose bytes get fanned back out to the awaiting coroutines. Must only be used from the thread running its context.
+/// @tparam Ctx The type of the context to submit the reads to.
+template <class Ctx>
+class io_scheduler
+{
+    struct request {
+        request *next;
+        detail::file::location l;
+        void *buf;
+        uint32_t nbytes;
+        std::coroutine_handle<> h;
+        std::size_t res;
+        std::exception_ptr ep;
+
+        uint64_t end() const noexcept { return l.offset + nbytes; }
+    };
+
+    class read_task : request
+    {
+        friend class io_scheduler;
+
+        KORU_inline read_task(io_scheduler &s, const detail::file::location l,
+                              void *const buf, const uint32_t nbytes) noexcept
+            : request{nullptr, l, buf, nbytes}, s_{s}
+        {
+        }
+
+      public:
+        KORU_defctor(read_task, = delete;);
+
+        bool await_ready() const noexcept { return !this->nbytes; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            this->h = h;
+            s_.enqueue(*this);
+        }
+        std::size_t await_resume() const
+        {
+            if (this->ep) [[unlikely]]
+                std::rethrow_exception(this->ep);
+            return this->res;
+        }
+
+      private:
+        io_scheduler &s_;
+    };
+
+  public:
+    /// @param ctx The context to submit the reads to.
+    /// @param opts The tunables of the scheduling.
+    [[nodiscard]] explicit io_scheduler(Ctx &ctx,
+                                        const io_scheduler_options opts = {})
+        : ctx_{ctx}, opts_{opts}
+    {
+    }
+    KORU_defctor(io_scheduler, = delete;);
+
+    /// @brief Like Ctx::read(), but the read is held back to be merged with others.
+    /// @param l A location on a file opened by the context with read access.
+    /// @param buf A pointer denoting the recipient buffer.
+    /// @param nbytes The maximum number of bytes to read.
+    /// @return Task object resulting in the number of bytes read; must be awaited on immediately.
+    [[nodiscard]] KORU_inline read_task read(const detail::file::location l,
+                                             void *const buf,
+                                             const uint32_t nbytes) noexcept
+    {
+        return {*this, l, buf, nbytes};
+    }
+
+    /// @return Counters describing how many reads got merged.
+    [[nodiscard]] io_scheduler_stats stats() const noexcept { return stats_; }
+
+    /// @return Whether reads are held back or in flight.
+    [[nodiscard]] bool busy() const noexcept { return dispatching_ || nruns_; }
+
+  private:
+    void enqueue(request &r)
+    {
+        ++stats_.requests;
+        r.next = nullptr;
+        (tail_ ? tail_->next : head_) = &r;
+        tail_                         = &r;
+        if (!dispatching_) {
+            dispatching_ = true;
+            detail::spawn([this] { return dispatch(); });
+        }
+    }
+
+    sync_task<void> dispatch()
+    {
+        while (head_) {
+            if (opts_.window.count())
+                co_await ctx_.sleep_for(opts_.window);
+            else
+                co_await ctx_.schedule();
+
+            batch_.clear();
+            for (auto r = std::exchange(head_, nullptr); r; r = r->next)
+                batch_.push_back(r);
+            tail_ = nullptr;
+            std::sort(batch_.begin(), batch_.end(),
+                      [](const request *a, const request *b) {
+                          return a->l.handle != b->l.handle
+                                     ? std::less<>{}(a->l.handle, b->l.handle)
+                                     : a->l.offset < b->l.offset;
+                      });
+
+            // Chain the requests of each run, moving its head to the front.
+            // All runs are formed before any is started, as starting one may
+            // resume coroutines, destroying their requests.
+            std::size_t nruns = 0;
+            for (std::size_t i = 0; i < batch_.size();) {
+                const auto head = batch_[i];
+                auto tail       = head;
+                auto end        = head->end();
+                while (++i < batch_.size()) {
+                    const auto r = batch_[i];
+                    if (r->l.handle != head->l.handle ||
+                        r->l.offset > end + opts_.max_gap ||
+                        std::max(end, r->end()) - head->l.offset >
+                            opts_.max_read)
+                        break;
+                    tail = tail->next = r;
+                    end               = std::max(end, r->end());
+                }
+                tail->next      = nullptr;
+                batch_[nruns++] = head;
+            }
+            nruns_ += nruns;
+            stats_.reads += nruns;
+            for (std::size_t i = 0; i < nruns; ++i)
+                detail::spawn([this, r = batch_[i]] { return read_run(r); });
+        }
+        dispatching_ = false;
+    }
+
+    sync_task<void> read_run(request *const head)
+    {
+        std::exception_ptr ep;
+        try {
+            if (!head->next) {
+                head->res =
+                    co_await ctx_.read(head->l, head->buf, head->nbytes);
+            } else {
+                // The merged read goes out in the most urgent class of its
+                // requests, so none waits behind a lower class than its own
+                auto l   = head->l;
+                auto end = head->end();
+                for (auto r = head->next; r; r = r->next) {
+                    end        = std::max(end, r->end());
+                    l.priority = std::min(l.priority, r->l.priority);
+                }
+                const auto len = static_cast<uint32_t>(end - l.offset);
+                const auto buf = std::make_unique_for_overwrite<char[]>(len);
+                const auto got = co_await ctx_.read(l, buf.get(), len);
+                for (auto r = head; r; r = r->next) {
+                    const auto skip =
+                        static_cast<std::size_t>(r->l.offset - head->l.offset);
+                    r->res = got > skip ? std::min<std::size_t>(r->nbytes,
+                                                                got - skip)
+                                        : 0;
+                    std::memcpy(r->buf, buf.get() + skip, r->res);
+                }
+            }
+        } catch (...) {
+            ep = std::current_exception();
+        }
+        --nruns_;
+        for (auto r = head; r;) {
+            // The resumed coroutine may destroy the request
+            const auto next = r->next;
+            r->ep           = ep;
+            r->h.resume();
+            r = next;
+        }
+    }
+
+    Ctx &ctx_;
+    io_scheduler_options opts_;
+    io_scheduler_stats stats_{};
+    request *head_ = nullptr, *tail_ = nullptr;
+    std::vector<request *> batch_;
+    std::size_t nruns_ = 0;
+    bool dispatching_  = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+} // namespace koru
\ No newline at end of file
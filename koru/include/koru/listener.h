@@ -0,0 +1,147 @@
+//
+// LISTENER : Accepts spread across the shards of a runtime
+//
+
+#pragma once
+
+#include "runtime.h"
+#include "sync_task.h"
+#include <atomic>
+#include <cstddef>
+#include <system_error>
+
+#include "detail/win_macros_begin.inl"
+
+namespace koru
+{
+namespace detail
+{
+/// @brief Cancels the outstanding operations on a socket, whichever thread started them.
+void cancel_io(SOCKET s) noexcept;
+/// @return The logical processor RSS steers the packets of a connection to, numbered as in runtime, or -1 if unknown.
+int rss_processor(SOCKET s) noexcept;
+} // namespace detail
+
+/// @brief The tunables of a listener.
+struct listener_options {
+    /// The number of accepts each shard keeps outstanding, so that a burst of connections gets accepted in parallel.
+    unsigned accepts_per_shard = 4;
+    /// Whether to serve each connection on the shard pinned onto the processor RSS steers its packets to, so that both share a core, rather than on the shard that accepted it.
+    bool steer = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
+/// @brief Accepts connections on a listening socket from all shards of a runtime at once, and serves each with a task of its own. Windows has no SO_REUSEPORT balancing connections among several sockets, so the shards share one socket, the kernel handing each connection to the accept posted first; as every shard keeps several accepts outstanding, accepting never waits on a single thread.
+/// @tparam Ctx The type of the context of each shard.
+/// @tparam F The type of the callable serving connections.
+template <class Ctx, class F>
+class listener
+{
+  public:
+    /// @param rt The runtime whose shards accept and serve connections; must outlive the connections.
+    /// @param ls A socket created by context::listen(); must outlive *this.
+    /// @param f A callable taking a context and a connected socket, and returning the task serving the connection on the thread running that context, e.g., a sync_task. It gets copied for each connection, whose socket gets closed once the task completes; exceptions escaping the task are dropped.
+    /// @param opts The tunables of *this.
+    [[nodiscard]] listener(runtime<Ctx> &rt, const detail::socket &ls, F f,
+                           const listener_options opts = {})
+        : rt_{rt}, ls_{ls}, f_{static_cast<F &&>(f)}, opts_{opts}
+    {
+        KORU_assert(opts_.accepts_per_shard);
+        for (std::size_t i = 0; i < rt_.size(); ++i)
+            for (unsigned j = 0; j < opts_.accepts_per_shard; ++j)
+                accept_on(i);
+    }
+    KORU_defctor(listener, = delete;);
+    ~listener() { stop(); }
+
+    /// @brief Stops accepting, waiting for the outstanding accepts to be cancelled. Connections being served are unaffected. Must not be called from a shard's thread.
+    void stop() noexcept
+    {
+        if (!stopping_.exchange(true, std::memory_order_acq_rel)) {
+            // Shards only start accepts in between their messages, so none
+            // gets started after the cancellation on its shard
+            for (std::size_t i = 0; i < rt_.size(); ++i)
+                rt_.shard(i).post(
+                    [s = ls_.native_handle] { detail::cancel_io(s); });
+        }
+        for (auto n = outstanding_.load(); n; n = outstanding_.load())
+            outstanding_.wait(n);
+    }
+
+    /// @return The number of connections accepted so far.
+    [[nodiscard]] std::size_t accepted() const noexcept
+    {
+        return accepted_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    void accept_on(const std::size_t i)
+    {
+        outstanding_.fetch_add(1, std::memory_order_relaxed);
+        rt_.shard(i).spawn([this, i] { return serve(i); });
+    }
+
+    /// @brief Marks an accept as no longer outstanding, after which *this may be gone.
+    void accept_done() noexcept
+    {
+        if (outstanding_.fetch_sub(1, std::memory_order_release) == 1)
+            outstanding_.notify_all();
+    }
+
+    std::size_t steer(const detail::socket &s, const std::size_t i) noexcept
+    {
+        if (const auto cpu = detail::rss_processor(s.native_handle);
+            cpu >= 0 && rt_.shard(i).cpu() != static_cast<unsigned>(cpu))
+            for (std::size_t j = 0; j < rt_.size(); ++j)
+                if (rt_.shard(j).cpu() == static_cast<unsigned>(cpu))
+                    return j;
+        return i;
+    }
+
+    // Accepts a connection and serves it, so that the socket stays in the
+    // frame of a single coroutine throughout
+    sync_task<void> serve(const std::size_t i)
+    {
+        if (stopping_.load(std::memory_order_acquire)) {
+            accept_done();
+            co_return;
+        }
+        auto &rt = rt_;
+        try {
+            const auto s = co_await rt.shard(i).ctx().accept(ls_);
+            accept_on(i);
+            accepted_.fetch_add(1, std::memory_order_relaxed);
+            const auto j = opts_.steer ? steer(s, i) : i;
+            auto f       = f_;
+            accept_done();
+
+            // *this may be gone from here on, so nothing may reach the
+            // handlers below
+            try {
+                if (j != i)
+                    co_await resume_on(rt.shard(j).ctx());
+                co_await f(rt.shard(j).ctx(), s);
+            } catch (...) {
+            }
+        } catch (const std::system_error &e) {
+            // Clients resetting before being accepted are no reason to stop
+            if (e.code().value() == WSAECONNRESET &&
+                !stopping_.load(std::memory_order_acquire))
+                accept_on(i);
+            accept_done();
+        } catch (...) {
+            accept_done();
+        }
+    }
+
+    runtime<Ctx> &rt_;
+    const detail::socket &ls_;
+    F f_;
+    listener_options opts_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::size_t> outstanding_{0}, accepted_{0};
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+} // namespace koru
+
+#include "detail/win_macros_end.inl"
\ No newline at end of file
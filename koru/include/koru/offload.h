@@ -0,0 +1,77 @@
+//
+// OFFLOAD POOL : Threads for running blocking work on behalf of a context
+//
+
+#pragma once
+
+#include "detail/utils.h"
+#include "detail/winapi.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace koru
+{
+/// @brief The bounds of the thread pool backing context::offload().
+struct offload_limits {
+    /// The number of threads in the pool.
+    std::size_t threads = 4;
+    /// The maximum number of queued jobs; beyond it, jobs are run inline.
+    std::size_t max_queue = 1024;
+};
+
+/// @brief Counters describing the use of the thread pool backing context::offload().
+struct offload_stats {
+    /// The number of jobs queued onto the pool.
+    std::size_t submitted;
+    /// The number of queued jobs the pool has finished.
+    std::size_t completed;
+    /// The number of jobs run inline on the submitting thread as the queue was full.
+    std::size_t inlined;
+    /// The greatest number of jobs that have been queued at once.
+    std::size_t max_depth;
+};
+
+namespace detail
+{
+/// @brief A unit of work for offload_pool. Lives in the frame of the coroutine awaiting it.
+struct offload_job {
+    offload_job *next;
+    /// Does the work; the pool signals ev after this returns.
+    void (*run)(offload_job *) noexcept;
+    HANDLE ev;
+};
+
+class offload_pool
+{
+  public:
+    offload_pool(offload_limits limits);
+    KORU_defctor(offload_pool, = delete;);
+    ~offload_pool();
+
+    /// @brief Queues a job to be run by one of the threads of *this.
+    /// @return Whether the job was queued; fails if the queue is full.
+    bool submit(offload_job &job) noexcept;
+
+    /// @brief Counts a job that was run inline as submit() failed.
+    void count_inlined() noexcept;
+
+    [[nodiscard]] offload_stats stats() noexcept;
+
+  private:
+    void stop() noexcept;
+    void work() noexcept;
+
+    std::mutex m_;
+    std::condition_variable cv_;
+    offload_job *head_ = nullptr, *tail_ = nullptr;
+    std::size_t depth_ = 0, max_queue_;
+    offload_stats stats_{};
+    bool stop_ = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+    std::vector<std::thread> threads_;
+};
+} // namespace detail
+} // namespace koru
\ No newline at end of file
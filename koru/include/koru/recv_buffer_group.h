@@ -0,0 +1,199 @@
+//
+// RECV BUFFER GROUP : Shared receive buffers picked once data arrives
+//
+
+#pragma once
+
+#include "context.h"
+#include <cstddef>
+#include <memory>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "detail/win_macros_begin.inl"
+
+namespace koru
+{
+namespace detail
+{
+/// @brief Checks whether the peer of a stream socket with something to receive closed the connection, without receiving anything.
+/// @param err Set to the error pending on the socket, if any.
+/// @return Whether the end of the stream is next to receive.
+bool at_stream_end(SOCKET s, int &err) noexcept;
+} // namespace detail
+
+class recv_buffer_group;
+
+/// @brief Owns a buffer of a recv_buffer_group holding received bytes, returning it to the group on destruction.
+class recv_buffer
+{
+    friend class recv_buffer_group;
+
+    recv_buffer(recv_buffer_group &g, const uint32_t idx,
+                const uint32_t nbytes) noexcept
+        : g_{&g}, idx_{idx}, nbytes_{nbytes}
+    {
+    }
+
+  public:
+    constexpr recv_buffer() noexcept = default;
+    recv_buffer(recv_buffer &&other) noexcept
+        : g_{std::exchange(other.g_, nullptr)}, idx_{other.idx_},
+          nbytes_{std::exchange(other.nbytes_, 0)}
+    {
+    }
+    recv_buffer &operator=(recv_buffer &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            g_      = std::exchange(other.g_, nullptr);
+            idx_    = other.idx_;
+            nbytes_ = std::exchange(other.nbytes_, 0);
+        }
+        return *this;
+    }
+    ~recv_buffer() { reset(); }
+
+    /// @return The received bytes.
+    [[nodiscard]] std::byte *data() const noexcept;
+
+    /// @return The number of received bytes.
+    [[nodiscard]] uint32_t size() const noexcept { return nbytes_; }
+
+    /// @return Whether *this holds a buffer; receiving results in none at the end of the stream.
+    [[nodiscard]] explicit operator bool() const noexcept
+    {
+        return g_ != nullptr;
+    }
+
+    /// @brief Returns the buffer to its group early.
+    void reset() noexcept;
+
+  private:
+    recv_buffer_group *g_ = nullptr;
+    uint32_t idx_ = 0, nbytes_ = 0;
+};
+
+/// @brief A pool of receive buffers shared by the stream sockets of a context. Rather than parking a buffer of its own, a receive awaits data with a zero-byte WSARecv and only takes a buffer once data has arrived, so memory scales with the traffic rather than with the number of idle connections. Must only be used from the thread running its context.
+class recv_buffer_group
+{
+    friend class recv_buffer;
+
+    template <class Ctx>
+    class recv_task
+    {
+        friend class recv_buffer_group;
+
+        KORU_inline recv_task(recv_buffer_group &g, Ctx &ctx,
+                              const detail::socket &s)
+            : g_{g}, s_{s.native_handle}, wait_{ctx.try_recv(s, nullptr, 0)}
+        {
+        }
+
+      public:
+        KORU_defctor(recv_task, = delete;);
+
+        bool await_ready() const noexcept { return wait_.await_ready(); }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            wait_.await_suspend(h);
+        }
+        recv_buffer await_resume()
+        {
+            if (const auto res = wait_.await_resume(); !res) [[unlikely]]
+                throw std::system_error{res.error()};
+            return g_.take(s_);
+        }
+
+      private:
+        recv_buffer_group &g_;
+        detail::SOCKET s_;
+        decltype(std::declval<Ctx &>().try_recv(
+            std::declval<const detail::socket &>(), nullptr, 0)) wait_;
+    };
+
+  public:
+    /// @param count The number of buffers, i.e., of receives that can hold on to data at once.
+    /// @param size The size of each buffer in bytes.
+    [[nodiscard]] recv_buffer_group(const uint32_t count, const uint32_t size)
+        : mem_{std::make_unique_for_overwrite<std::byte[]>(std::size_t{count} *
+                                                           size)},
+          count_{count}, size_{size}
+    {
+        KORU_assert(count_ && size_);
+        free_.reserve(count);
+        // The lowest buffers get handed out first
+        for (auto i = count; i--;)
+            free_.push_back(i);
+    }
+    KORU_defctor(recv_buffer_group, = delete;);
+    ~recv_buffer_group() { KORU_assert(free_.size() == count_); }
+
+    /// @brief Waits for data on a stream socket, then receives as much of it as fits into a buffer of the group.
+    /// @param ctx The context that created the socket.
+    /// @param s A stream socket created by ctx.
+    /// @return Task object resulting in the buffer holding the received bytes, or in an empty one at the end of the stream; throws WSAENOBUFS if no buffer is free, leaving the data to a later receive. Must be awaited on immediately.
+    template <class Ctx>
+    [[nodiscard]] KORU_inline recv_task<Ctx> recv(Ctx &ctx,
+                                                  const detail::socket &s)
+    {
+        return {*this, ctx, s};
+    }
+
+    /// @return The number of buffers not held by a recv_buffer.
+    [[nodiscard]] std::size_t available() const noexcept
+    {
+        return free_.size();
+    }
+
+  private:
+    std::byte *buffer(const uint32_t idx) const noexcept
+    {
+        return mem_.get() + std::size_t{idx} * size_;
+    }
+
+    recv_buffer take(const detail::SOCKET s)
+    {
+        if (free_.empty()) [[unlikely]] {
+            // The end of the stream takes no buffer
+            int err;
+            if (detail::at_stream_end(s, err))
+                return {};
+            throw std::system_error{detail::wsa_error(err ? err : WSAENOBUFS)};
+        }
+        // Data is known to be there, so the receive doesn't block
+        const auto idx = free_.back();
+        msg_buf m{.data = buffer(idx), .size = size_};
+        int err;
+        if (!detail::transfer_available(s, &m, 1, false, err)) {
+            if (err) [[unlikely]]
+                throw std::system_error{detail::wsa_error(err)};
+            return {};
+        }
+        if (!m.nbytes)
+            return {};
+        free_.pop_back();
+        return {*this, idx, m.nbytes};
+    }
+
+    std::unique_ptr<std::byte[]> mem_;
+    std::vector<uint32_t> free_;
+    uint32_t count_, size_;
+};
+
+inline std::byte *recv_buffer::data() const noexcept
+{
+    KORU_assert(g_);
+    return g_->buffer(idx_);
+}
+
+inline void recv_buffer::reset() noexcept
+{
+    if (g_)
+        std::exchange(g_, nullptr)->free_.push_back(idx_);
+    nbytes_ = 0;
+}
+} // namespace koru
+
+#include "detail/win_macros_end.inl"
\ No newline at end of file
@@ -0,0 +1,275 @@
+//
+// RUNTIME : Shared-nothing shards, each running a context on a pinned thread
+//
+
+#pragma once
+
+#include "context.h"
+#include "sync_task.h"
+#include <atomic>
+#include <exception>
+#include <latch>
+#include <new>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace koru
+{
+namespace detail
+{
+unsigned processor_count() noexcept;
+/// @brief Pins the calling thread onto the given logical processor.
+/// @return The NUMA node of the processor.
+unsigned pin_thread(unsigned cpu);
+void *numa_alloc(std::size_t nbytes, unsigned node);
+void numa_free(void *p) noexcept;
+
+/// @brief Intrusive multi-producer single-consumer queue of callables.
+class mailbox
+{
+    struct message {
+        message *next;
+        void (*fn)(message *, bool run) noexcept;
+    };
+    template <class F>
+    struct message_of : message {
+        F f;
+    };
+
+  public:
+    KORU_defctor(mailbox, = default;);
+    ~mailbox()
+    {
+        for (auto m = head_.load(std::memory_order_acquire); m;)
+            m->fn(std::exchange(m, m->next), false);
+    }
+
+    /// @brief Enqueues a callable to be invoked by the consumer. Can be called from any thread.
+    /// @param f The callable to invoke; an exception escaping it terminates the program.
+    template <class F>
+    void post(F &&f)
+    {
+        using M = message_of<std::decay_t<F>>;
+
+        message *const m = new M{{nullptr,
+                                  [](message *m, bool run) noexcept {
+                                      const auto p = static_cast<M *>(m);
+                                      if (run)
+                                          p->f();
+                                      delete p;
+                                  }},
+                                 static_cast<F &&>(f)};
+        m->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(m->next, m,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed))
+            ;
+    }
+
+    /// @brief Invokes the enqueued callables in the order they were posted in. Must be called by the consumer.
+    /// @return The number of callables invoked.
+    std::size_t drain()
+    {
+        // The messages got pushed LIFO; reverse them first
+        message *fifo = nullptr;
+        for (auto m = head_.exchange(nullptr, std::memory_order_acquire); m;) {
+            const auto next = m->next;
+            m->next         = fifo;
+            fifo            = m;
+            m               = next;
+        }
+        std::size_t n = 0;
+        for (; fifo; ++n)
+            fifo->fn(std::exchange(fifo, fifo->next), true);
+        return n;
+    }
+
+  private:
+    std::atomic<message *> head_{nullptr};
+};
+} // namespace detail
+
+template <class>
+class runtime;
+
+/// @brief A context with a thread of its own. Lives on the NUMA node of the processor its thread is pinned onto.
+/// @tparam Ctx The type of the context; has to have AsyncIos set.
+template <class Ctx>
+class shard
+{
+    friend class runtime<Ctx>;
+
+    shard(const unsigned cpu, const unsigned node) noexcept
+        : cpu_{cpu}, node_{node}
+    {
+    }
+
+  public:
+    KORU_defctor(shard, = delete;);
+
+    /// @return The context of *this. I/Os may be submitted to it from any thread.
+    [[nodiscard]] Ctx &ctx() noexcept { return ctx_; }
+
+    /// @return The logical processor the thread of *this is pinned onto.
+    [[nodiscard]] unsigned cpu() const noexcept { return cpu_; }
+
+    /// @return The NUMA node the thread and the memory of *this reside on.
+    [[nodiscard]] unsigned node() const noexcept { return node_; }
+
+    /// @brief Has the thread of *this invoke the given callable. Can be called from any thread.
+    /// @param f The callable to invoke; an exception escaping it terminates the program.
+    template <class F>
+    void post(F &&f)
+    {
+        mail_.post(static_cast<F &&>(f));
+        ctx_.notify();
+    }
+
+    /// @brief Starts a task on the thread of *this, running it to completion. Can be called from any thread.
+    /// @param f A callable returning the task to run, e.g., a sync_task; an exception escaping the task terminates the program.
+    template <class F>
+    void spawn(F f)
+    {
+        post([f = static_cast<F &&>(f)]() mutable {
+            detail::spawn(static_cast<F &&>(f));
+        });
+    }
+
+    /// @brief Allocates memory on the NUMA node of *this. Allocations are page-granular, so this is meant for long-lived buffers.
+    /// @param nbytes The size of the allocation in bytes.
+    /// @return A pointer to the allocated memory; to be freed with deallocate().
+    [[nodiscard]] void *allocate(const std::size_t nbytes)
+    {
+        return detail::numa_alloc(nbytes, node_);
+    }
+
+    /// @brief Frees memory obtained from allocate().
+    void deallocate(void *const p) noexcept { detail::numa_free(p); }
+
+  private:
+    Ctx ctx_;
+    detail::mailbox mail_;
+    unsigned cpu_, node_;
+    std::atomic<bool> stop_{false};
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
+/// @brief Runs one shard per processor, each on a thread of its own that's pinned onto the processor.
+/// @tparam Ctx The type of the context of each shard; has to have AsyncIos set.
+template <class Ctx = context<true, true>>
+class runtime
+{
+    static_assert(requires(Ctx & c) { c.notify(); },
+                  "shard contexts need AsyncIos");
+
+  public:
+    /// @brief Creates a shard for each processor.
+    [[nodiscard]] KORU_defctor(runtime, : runtime(all_processors()){});
+
+    /// @brief Creates a shard for each of the given processors.
+    /// @param cpus Logical processor indices, numbered consecutively across processor groups.
+    [[nodiscard]] explicit runtime(const std::span<const unsigned> cpus)
+        : shards_(cpus.size()), errors_(cpus.size())
+    {
+        std::latch ready{static_cast<std::ptrdiff_t>(cpus.size())};
+        threads_.reserve(cpus.size());
+        try {
+            for (std::size_t i = 0; i < cpus.size(); ++i)
+                threads_.emplace_back([this, i, cpu = cpus[i], &ready] {
+                    work(i, cpu, ready);
+                });
+        } catch (...) {
+            // The started threads must be done with ready before they're
+            // stopped; the ones that failed to start count for nothing
+            ready.count_down(
+                static_cast<std::ptrdiff_t>(cpus.size() - threads_.size()));
+            ready.wait();
+            stop();
+            throw;
+        }
+        ready.wait();
+        for (auto &ep : errors_) {
+            if (ep) {
+                stop();
+                std::rethrow_exception(ep);
+            }
+        }
+    }
+
+    /// @brief Stops the shards after letting them finish their outstanding I/Os and messages.
+    ~runtime() { stop(); }
+
+    /// @return The number of shards in *this.
+    [[nodiscard]] std::size_t size() const noexcept { return shards_.size(); }
+
+    /// @param i The index of a shard in [0, size()).
+    /// @return The shard at the given index.
+    [[nodiscard]] koru::shard<Ctx> &shard(const std::size_t i) noexcept
+    {
+        KORU_assert(i < shards_.size());
+        return *shards_[i];
+    }
+
+  private:
+    static std::vector<unsigned> all_processors()
+    {
+        std::vector<unsigned> cpus(detail::processor_count());
+        for (unsigned i = 0; i < cpus.size(); ++i)
+            cpus[i] = i;
+        return cpus;
+    }
+
+    void work(const std::size_t i, const unsigned cpu, std::latch &ready)
+    {
+        // The shard gets allocated from the thread it's pinned onto, so that
+        // the memory gets committed on the local NUMA node.
+        try {
+            const auto node = detail::pin_thread(cpu);
+            const auto p = detail::numa_alloc(sizeof(koru::shard<Ctx>), node);
+            try {
+                shards_[i] = new (p) koru::shard<Ctx>{cpu, node};
+            } catch (...) {
+                detail::numa_free(p);
+                throw;
+            }
+        } catch (...) {
+            errors_[i] = std::current_exception();
+            ready.count_down();
+            return;
+        }
+        ready.count_down();
+
+        auto &s = *shards_[i];
+        while (!s.stop_.load(std::memory_order_acquire)) {
+            s.mail_.drain();
+            s.ctx_.run_until_notified();
+        }
+        s.mail_.drain();
+        s.ctx_.run();
+    }
+
+    void stop() noexcept
+    {
+        for (const auto s : shards_) {
+            if (s) {
+                s->stop_.store(true, std::memory_order_release);
+                s->ctx_.notify();
+            }
+        }
+        for (auto &t : threads_)
+            t.join();
+        threads_.clear();
+        for (auto &s : shards_) {
+            if (s) {
+                s->~shard();
+                detail::numa_free(std::exchange(s, nullptr));
+            }
+        }
+    }
+
+    std::vector<koru::shard<Ctx> *> shards_;
+    std::vector<std::exception_ptr> errors_;
+    std::vector<std::thread> threads_;
+};
+} // namespace koru
\ No newline at end of file
@@ -0,0 +1,226 @@
+//
+// DIRECTORY SCAN : Recursive directory walk reading many directories at once
+//
+
+#pragma once
+
+#include "async_generator.h"
+#include "context.h"
+#include "sync_task.h"
+#include <deque>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "detail/win_macros_begin.inl"
+
+namespace koru
+{
+/// @brief The tunables of scan_dir().
+struct scan_options {
+    /// The greatest number of directories being read at once.
+    std::size_t max_open = 8;
+    /// The number of found entries beyond which reading pauses until they're consumed.
+    std::size_t max_buffered = 4096;
+    /// The size in bytes of the buffer each directory is read into at once.
+    uint32_t batch_bytes = 64 << 10;
+    /// Whether to descend into subdirectories. Directory reparse points, e.g., symbolic links, are never followed.
+    bool recursive = true;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
+namespace detail
+{
+HANDLE open_dir(const wchar_t *path);
+/// @brief Reads the next batch of entries of a directory, skipping "." and "..".
+/// @return Whether there were any entries left to read.
+bool read_dir(HANDLE h, const std::wstring &dir, void *buf, std::size_t nbytes,
+              std::vector<dir_entry> &out);
+} // namespace detail
+
+/// @brief Yields the entries of a directory tree, reading several directories at once on the thread pool of a context. Subdirectories are read depth-first, which keeps the number of directories found but not yet read small. Must only be used from the thread running the context.
+/// @tparam Ctx The type of the context to read the directories through.
+template <class Ctx>
+class dir_scanner
+{
+    // The state shared by the scanner and the coroutines reading directories,
+    // which keep it alive until they notice the scan got abandoned
+    struct state {
+        Ctx &ctx;
+        scan_options opts;
+        std::vector<std::wstring> pending;
+        std::deque<dir_entry> found;
+        std::vector<detail::ready_node *> parked;
+        detail::ready_node *consumer = nullptr;
+        std::exception_ptr ep;
+        std::size_t nreaders = 0;
+        bool abandoned       = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+
+        bool done() const noexcept
+        {
+            return ep || (found.empty() && !nreaders);
+        }
+
+        // Resumes the consumer if it has something to resume to
+        void wake_consumer() noexcept
+        {
+            if (consumer && (done() || !found.empty()))
+                ctx.post(*std::exchange(consumer, nullptr));
+        }
+    };
+
+    class next_task : detail::ready_node
+    {
+        friend class dir_scanner;
+
+        KORU_inline next_task(dir_scanner &s) noexcept
+            : detail::ready_node{}, s_{s}
+        {
+        }
+
+      public:
+        KORU_defctor(next_task, = delete;);
+
+        bool await_ready() const noexcept
+        {
+            return s_.st_->done() || !s_.st_->found.empty();
+        }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            this->h          = h;
+            s_.st_->consumer = this;
+        }
+        const dir_entry *await_resume() { return s_.take(); }
+
+      private:
+        dir_scanner &s_;
+    };
+
+    // Suspends a reader until the consumer catches up
+    struct park_task : detail::ready_node {
+        state &st;
+
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            this->h = h;
+            st.parked.push_back(this);
+        }
+        constexpr void await_resume() const noexcept {}
+    };
+
+  public:
+    /// @param ctx The context to read the directories through.
+    /// @param root The path of the directory to scan.
+    /// @param opts The tunables of the scan.
+    [[nodiscard]] dir_scanner(Ctx &ctx, std::wstring root,
+                              const scan_options opts = {})
+        : st_{std::make_shared<state>(state{.ctx = ctx, .opts = opts})}
+    {
+        st_->pending.push_back(std::move(root));
+        start_readers(st_);
+    }
+    KORU_defctor(dir_scanner, = delete;);
+
+    /// @brief Abandons the scan; the directories being read are closed as soon as their current batch arrives.
+    ~dir_scanner()
+    {
+        st_->abandoned = true;
+        st_->consumer  = nullptr;
+        for (const auto n : std::exchange(st_->parked, {}))
+            st_->ctx.post(*n);
+    }
+
+    /// @brief Waits for the next entry. The first failure to open or read a directory ends the scan, getting rethrown.
+    /// @return Task object resulting in a pointer to the entry, valid until the next call, or nullptr once there are no entries left; must be awaited on immediately.
+    [[nodiscard]] KORU_inline next_task next() noexcept { return {*this}; }
+
+  private:
+    const dir_entry *take()
+    {
+        auto &st = *st_;
+        if (st.ep)
+            std::rethrow_exception(st.ep);
+        if (st.found.empty())
+            return nullptr;
+        current_ = std::move(st.found.front());
+        st.found.pop_front();
+        if (st.found.size() <= st.opts.max_buffered / 2)
+            for (const auto n : std::exchange(st.parked, {}))
+                st.ctx.post(*n);
+        return &current_;
+    }
+
+    static void start_readers(const std::shared_ptr<state> &st)
+    {
+        // Readers spawned after the scan ended would return at once, which
+        // would keep this loop going forever
+        while (!st->abandoned && !st->ep &&
+               st->nreaders < st->opts.max_open &&
+               st->pending.size() > st->nreaders) {
+            ++st->nreaders;
+            detail::spawn([st] { return read_dirs(st); });
+        }
+    }
+
+    static sync_task<void> read_dirs(const std::shared_ptr<state> st)
+    {
+        auto &ctx      = st->ctx;
+        const auto buf = std::make_unique_for_overwrite<char[]>(
+            st->opts.batch_bytes);
+        std::vector<dir_entry> batch;
+        while (!st->abandoned && !st->ep && !st->pending.empty()) {
+            const auto dir = std::move(st->pending.back());
+            st->pending.pop_back();
+            try {
+                const auto h = co_await ctx.offload(
+                    [&] { return detail::open_dir(dir.c_str()); });
+                KORU_defer[h] { CloseHandle(h); };
+                for (bool more = true; more && !st->abandoned && !st->ep;) {
+                    if (st->found.size() >= st->opts.max_buffered)
+                        co_await park_task{{}, *st};
+                    batch.clear();
+                    more = co_await ctx.offload([&] {
+                        return detail::read_dir(h, dir, buf.get(),
+                                                st->opts.batch_bytes, batch);
+                    });
+                    for (auto &e : batch) {
+                        if (st->opts.recursive && e.is_directory() &&
+                            !(e.attributes & FILE_ATTRIBUTE_REPARSE_POINT))
+                            st->pending.push_back(e.path);
+                        st->found.push_back(std::move(e));
+                    }
+                    start_readers(st);
+                    st->wake_consumer();
+                }
+            } catch (...) {
+                if (!st->ep)
+                    st->ep = std::current_exception();
+            }
+        }
+        --st->nreaders;
+        st->wake_consumer();
+    }
+
+    std::shared_ptr<state> st_;
+    dir_entry current_;
+};
+
+/// @brief Scans a directory tree; see dir_scanner. The scan starts once the first entry is asked for and gets abandoned along with the generator.
+/// @param ctx The context to read the directories through.
+/// @param root The path of the directory to scan.
+/// @param opts The tunables of the scan.
+/// @return Generator yielding the entries of the tree, in no particular order.
+template <class Ctx>
+async_generator<const dir_entry> scan_dir(Ctx &ctx, std::wstring root,
+                                         const scan_options opts = {})
+{
+    dir_scanner<Ctx> s{ctx, std::move(root), opts};
+    while (const auto e = co_await s.next())
+        co_yield *e;
+}
+} // namespace koru
+
+#include "detail/win_macros_end.inl"
\ No newline at end of file
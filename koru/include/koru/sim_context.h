@@ -0,0 +1,477 @@
+//
+// SIM CONTEXT : In-memory I/Os completed on a virtual clock
+//
+
+#pragma once
+
+#include "context.h"
+#include "expected.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace koru
+{
+/// @brief Draws the time a simulated I/O takes from the random engine of its context.
+using sim_latency = std::function<std::chrono::nanoseconds(std::mt19937_64 &)>;
+
+/// @return A latency model in which every I/O takes the same time, e.g., 0 to measure the overhead of the run loop alone.
+inline sim_latency fixed_latency(const std::chrono::nanoseconds d)
+{
+    return [d](std::mt19937_64 &) { return d; };
+}
+
+/// @return A latency model drawing evenly from [lo, hi].
+inline sim_latency uniform_latency(const std::chrono::nanoseconds lo,
+                                   const std::chrono::nanoseconds hi)
+{
+    return [dist = std::uniform_int_distribution<int64_t>{
+                lo.count(), hi.count()}](std::mt19937_64 &rng) mutable {
+        return std::chrono::nanoseconds{dist(rng)};
+    };
+}
+
+/// @return A latency model with a long tail, as storage devices tend to have: half of the I/Os take less than median, and sigma widens the spread.
+inline sim_latency lognormal_latency(const std::chrono::nanoseconds median,
+                                     const double sigma)
+{
+    return [dist = std::lognormal_distribution<double>{
+                std::log(static_cast<double>(median.count())),
+                sigma}](std::mt19937_64 &rng) mutable {
+        return std::chrono::nanoseconds{static_cast<int64_t>(dist(rng))};
+    };
+}
+
+/// @return A latency model replaying a recorded profile: each I/O takes one of the given latencies, e.g., as traced in production, drawn at random.
+inline sim_latency
+replayed_latency(std::vector<std::chrono::nanoseconds> samples)
+{
+    KORU_assert(!samples.empty());
+    return [s = std::move(samples)](std::mt19937_64 &rng) {
+        return s[std::uniform_int_distribution<std::size_t>{0, s.size() - 1}(
+            rng)];
+    };
+}
+
+/// @brief The behavior of the I/Os of a sim_context.
+struct sim_options {
+    /// The seed of the random engine drawing latencies and failures; the same seed replays the same run.
+    uint64_t seed = 0;
+    /// How long reads and writes take.
+    sim_latency latency = fixed_latency({});
+    /// The probability of a read or write failing.
+    double error_rate = 0;
+    /// The error failing I/Os complete with.
+    std::error_code error = std::make_error_code(std::errc::io_error);
+};
+
+/// @brief Counters describing the I/Os of a sim_context.
+struct sim_stats {
+    /// The number of reads and writes started.
+    std::size_t submitted;
+    /// The number of reads and writes completed, failed or not.
+    std::size_t completed;
+    /// The number of reads and writes failed on purpose.
+    std::size_t failed;
+};
+
+/// @brief The virtual clock of a sim_context, which only advances as the context completes I/Os and timers, and thus has no now() of its own; see sim_context::now().
+struct sim_clock {
+    using rep                       = int64_t;
+    using period                    = std::nano;
+    using duration                  = std::chrono::nanoseconds;
+    using time_point                = std::chrono::time_point<sim_clock>;
+    static constexpr bool is_steady = true;
+};
+
+/// @brief A file held in memory, to be operated on by a sim_context. Like a file's, its bytes aren't part of the object, so that writing through a const one works as with detail::file.
+class sim_file
+{
+  public:
+    /// @brief A byte offset into a file, as taken by read and write operations.
+    struct location {
+        uint64_t offset;
+        std::vector<std::byte> *bytes;
+    };
+
+    /// @brief Creates an empty file.
+    sim_file() = default;
+    /// @param bytes The initial contents of the file.
+    explicit sim_file(std::vector<std::byte> bytes) noexcept
+        : bytes_{std::move(bytes)}
+    {
+    }
+
+    /// @param offset A byte offset into *this.
+    /// @return The coupling of *this and given byte offset.
+    [[nodiscard]] location at(const uint64_t offset) const noexcept
+    {
+        return {offset, &bytes_};
+    }
+
+    /// @return The contents of the file, which I/Os only change once completed.
+    [[nodiscard]] std::vector<std::byte> &bytes() const noexcept
+    {
+        return bytes_;
+    }
+
+  private:
+    mutable std::vector<std::byte> bytes_;
+};
+
+/// @brief A context completing reads and writes of in-memory files after latencies drawn from a model, and failing some of them on purpose, as time passes on a virtual clock. Waiting takes no real time, the clock jumping to the next completion instead, and every run with the same options and submissions resumes the same coroutines in the same order, so that the cost of scheduling can be measured, and latency profiles replayed, free of storage noise. Mirrors the API of context for files, timers and scheduling, so that code taking its context as a template parameter, as well as channels and the synchronization primitives, runs on either. Must only be used from a single thread.
+class sim_context
+{
+    // An I/O or timer awaited on; lives in the frame of the suspended coro
+    struct op {
+        sim_clock::time_point due;
+        uint64_t seq; // Orders the ops due at once by submission
+        std::coroutine_handle<> h;
+    };
+
+    struct later {
+        bool operator()(const op *a, const op *b) const noexcept
+        {
+            return a->due != b->due ? a->due > b->due : a->seq > b->seq;
+        }
+    };
+
+    // Reports failures as values if Nothrow, or by throwing otherwise. Bytes
+    // get transferred upon completion; reading at or past the end of the
+    // file reads 0 bytes, and writing past it extends it.
+    template <bool Nothrow>
+    class file_task : op
+    {
+        friend class sim_context;
+
+        KORU_inline file_task(sim_context &c, const sim_file::location l,
+                              void *const buf, const uint32_t nbytes,
+                              const bool write) noexcept
+            : op{}, c_{c}, l_{l}, buf_{static_cast<std::byte *>(buf)},
+              nbytes_{nbytes}, write_{write}
+        {
+        }
+
+      public:
+        KORU_defctor(file_task, = delete;);
+
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            this->h = h;
+            failed_ = c_.fails();
+            c_.submit(*this, c_.draw_latency());
+            ++c_.stats_.submitted;
+        }
+        std::size_t await_resume() requires(!Nothrow)
+        {
+            const auto res = result();
+            if (!res) [[unlikely]]
+                throw std::system_error{res.error()};
+            return *res;
+        }
+        expected<std::size_t, std::error_code>
+        await_resume() noexcept requires Nothrow
+        {
+            return result();
+        }
+
+      private:
+        expected<std::size_t, std::error_code> result() noexcept
+        {
+            ++c_.stats_.completed;
+            if (failed_) [[unlikely]] {
+                ++c_.stats_.failed;
+                return unexpected{c_.opts_.error};
+            }
+            auto &bytes = *l_.bytes;
+            if (write_) {
+                if (l_.offset + nbytes_ > bytes.size())
+                    bytes.resize(l_.offset + nbytes_);
+                std::memcpy(bytes.data() + l_.offset, buf_, nbytes_);
+                return std::size_t{nbytes_};
+            }
+            if (l_.offset >= bytes.size())
+                return std::size_t{0};
+            const auto n = std::min<std::size_t>(
+                nbytes_, bytes.size() - static_cast<std::size_t>(l_.offset));
+            std::memcpy(buf_, bytes.data() + l_.offset, n);
+            return n;
+        }
+
+        sim_context &c_;
+        sim_file::location l_;
+        std::byte *buf_;
+        uint32_t nbytes_;
+        bool write_, failed_ = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+    class timer_task : op
+    {
+        friend class sim_context;
+
+        KORU_inline timer_task(sim_context &c,
+                               const sim_clock::time_point tp) noexcept
+            : op{tp, 0, {}}, c_{c}
+        {
+        }
+
+      public:
+        KORU_defctor(timer_task, = delete;);
+
+        bool await_ready() const noexcept { return due <= c_.now_; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            this->h = h;
+            c_.submit(*this, {});
+        }
+        constexpr void await_resume() const noexcept {}
+
+      private:
+        sim_context &c_;
+    };
+
+    class schedule_task : detail::ready_node
+    {
+        friend class sim_context;
+
+        KORU_inline schedule_task(sim_context &c) noexcept
+            : detail::ready_node{}, c_{c}
+        {
+        }
+
+      public:
+        KORU_defctor(schedule_task, = delete;);
+
+        constexpr bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            this->h = h;
+            c_.post(*this);
+        }
+        constexpr void await_resume() const noexcept {}
+
+      private:
+        sim_context &c_;
+    };
+
+  public:
+    /// @param opts The behavior of the I/Os of *this.
+    [[nodiscard]] explicit sim_context(sim_options opts = {})
+        : opts_{std::move(opts)}, rng_{opts_.seed}
+    {
+        KORU_assert(opts_.latency && opts_.error_rate >= 0 &&
+                    opts_.error_rate <= 1);
+    }
+    sim_context(const sim_context &)            = delete;
+    sim_context &operator=(const sim_context &) = delete;
+    ~sim_context() { KORU_assert(ops_.empty()); }
+
+    /// @brief Initiates the read of a file, completing once its latency has passed on the virtual clock.
+    /// @param l A location on a sim_file.
+    /// @param buf A pointer denoting the recipient buffer.
+    /// @param nbytes The maximum number of bytes to read.
+    /// @return Task object resulting in the number of bytes read; throws the error set in the options of *this if the read got failed. Must be awaited on immediately.
+    [[nodiscard]] KORU_inline file_task<false>
+    read(const sim_file::location l, void *const buf, const uint32_t nbytes)
+    {
+        return {*this, l, buf, nbytes, false};
+    }
+
+    /// @brief Like read(), but failures are reported as values rather than thrown.
+    /// @return Task object resulting in the number of bytes read or the error that occurred; must be awaited on immediately.
+    [[nodiscard]] KORU_inline file_task<true>
+    try_read(const sim_file::location l, void *const buf,
+             const uint32_t nbytes)
+    {
+        return {*this, l, buf, nbytes, false};
+    }
+
+    /// @brief Initiates the write of a file, completing once its latency has passed on the virtual clock.
+    /// @param l A location on a sim_file.
+    /// @param buf A pointer denoting the source buffer; must stay valid until the task completes.
+    /// @param nbytes The number of bytes to write.
+    /// @return Task object resulting in the number of bytes written; throws the error set in the options of *this if the write got failed. Must be awaited on immediately.
+    [[nodiscard]] KORU_inline file_task<false>
+    write(const sim_file::location l, const void *const buf,
+          const uint32_t nbytes)
+    {
+        return {*this, l, const_cast<void *>(buf), nbytes, true};
+    }
+
+    /// @brief Like write(), but failures are reported as values rather than thrown.
+    /// @return Task object resulting in the number of bytes written or the error that occurred; must be awaited on immediately.
+    [[nodiscard]] KORU_inline file_task<true>
+    try_write(const sim_file::location l, const void *const buf,
+              const uint32_t nbytes)
+    {
+        return {*this, l, const_cast<void *>(buf), nbytes, true};
+    }
+
+    /// @brief Suspends the awaiting coroutine for the given duration of virtual time.
+    /// @return Task object representing the wait; must be awaited on immediately.
+    template <class Rep, class Period>
+    [[nodiscard]] KORU_inline timer_task
+    sleep_for(const std::chrono::duration<Rep, Period> &d)
+    {
+        return {*this,
+                now_ + std::chrono::ceil<sim_clock::duration>(
+                           std::max(d, std::chrono::duration<Rep, Period>{}))};
+    }
+
+    /// @brief Suspends the awaiting coroutine until the given point in virtual time.
+    /// @return Task object representing the wait; must be awaited on immediately.
+    [[nodiscard]] KORU_inline timer_task
+    sleep_until(const sim_clock::time_point tp)
+    {
+        return {*this, tp};
+    }
+
+    /// @brief Suspends the awaiting coroutine to be resumed by the run loop of *this, taking no virtual time.
+    /// @return Task object representing the scheduling; must be awaited on immediately.
+    [[nodiscard]] KORU_inline schedule_task schedule() noexcept
+    {
+        return {*this};
+    }
+
+    /// @brief Enqueues a suspended coroutine to be resumed by the run loop of *this.
+    /// @param n The link to enqueue; must stay alive until the coroutine is resumed.
+    void post(detail::ready_node &n) noexcept
+    {
+        n.next                                          = nullptr;
+        (ready_tail_ ? ready_tail_->next : ready_head_) = &n;
+        ready_tail_                                     = &n;
+    }
+
+    /// @brief Resumes coroutines as their I/Os and timers complete, advancing the virtual clock to each completion, and the scheduled ones. Exits after running out of work.
+    /// @return The number of coroutines resumed.
+    std::size_t run()
+    {
+        for (std::size_t n = 0;;) {
+            n += resume_ready();
+            if (ops_.empty()) {
+                if (ready_head_)
+                    continue;
+                return n;
+            }
+            n += complete_next();
+        }
+    }
+
+    /// @brief Resumes the coroutines whose I/Os and timers are due by now, and the scheduled ones, without advancing the virtual clock.
+    /// @return The number of coroutines resumed.
+    std::size_t poll()
+    {
+        std::size_t n = resume_ready();
+        while (!ops_.empty() && ops_.front()->due <= now_)
+            n += complete_next();
+        return n;
+    }
+
+    /// @brief Resumes a single coroutine, advancing the virtual clock to the next completion unless one is scheduled.
+    /// @return The number of coroutines resumed; either 0 or 1.
+    std::size_t run_once()
+    {
+        if (resume_ready(1))
+            return 1;
+        return ops_.empty() ? 0 : complete_next();
+    }
+
+    /// @brief Like run(), but leaves the completions due after the given duration of virtual time, advancing the virtual clock by that much.
+    /// @return The number of coroutines resumed.
+    template <class Rep, class Period>
+    std::size_t run_for(const std::chrono::duration<Rep, Period> &d)
+    {
+        return run_until(now_ + std::chrono::ceil<sim_clock::duration>(d));
+    }
+
+    /// @brief Like run(), but leaves the completions due after the given point in virtual time, advancing the virtual clock up to it.
+    /// @return The number of coroutines resumed.
+    std::size_t run_until(const sim_clock::time_point tp)
+    {
+        for (std::size_t n = 0;;) {
+            n += resume_ready();
+            if (ops_.empty() || ops_.front()->due > tp) {
+                if (ready_head_)
+                    continue;
+                now_ = std::max(now_, tp);
+                return n;
+            }
+            n += complete_next();
+        }
+    }
+
+    /// @return The current point in virtual time, which starts out at the clock's epoch.
+    [[nodiscard]] sim_clock::time_point now() const noexcept { return now_; }
+
+    /// @return Counters describing the I/Os of *this.
+    [[nodiscard]] koru::sim_stats stats() const noexcept { return stats_; }
+
+  private:
+    bool fails()
+    {
+        return opts_.error_rate > 0 &&
+               std::bernoulli_distribution{opts_.error_rate}(rng_);
+    }
+
+    sim_clock::duration draw_latency()
+    {
+        return std::max(opts_.latency(rng_), sim_clock::duration{});
+    }
+
+    void submit(op &o, const sim_clock::duration latency)
+    {
+        o.due = std::max(o.due, now_ + latency);
+        o.seq = seq_++;
+        ops_.push_back(&o);
+        std::push_heap(ops_.begin(), ops_.end(), later{});
+    }
+
+    std::size_t complete_next()
+    {
+        std::pop_heap(ops_.begin(), ops_.end(), later{});
+        const auto o = ops_.back();
+        ops_.pop_back();
+        now_ = std::max(now_, o->due);
+        o->h.resume();
+        return 1;
+    }
+
+    /// @brief Resumes the coroutines scheduled onto *this. Coroutines scheduled meanwhile are left for the next call.
+    /// @param max The maximum number of coroutines to resume.
+    /// @return The number of coroutines resumed.
+    std::size_t resume_ready(const std::size_t max = SIZE_MAX)
+    {
+        const auto last = ready_tail_;
+        std::size_t n   = 0;
+        while (n < max && ready_head_) {
+            const auto node = ready_head_;
+            if (!(ready_head_ = node->next))
+                ready_tail_ = nullptr;
+            ++n;
+            const auto was_last = node == last;
+            node->h.resume();
+            if (was_last)
+                break;
+        }
+        return n;
+    }
+
+    sim_options opts_;
+    std::mt19937_64 rng_;
+    sim_clock::time_point now_{};
+    uint64_t seq_ = 0;
+    std::vector<op *> ops_; // A min-heap by due time
+    detail::ready_node *ready_head_ = nullptr, *ready_tail_ = nullptr;
+    koru::sim_stats stats_{};
+};
+} // namespace koru
\ No newline at end of file
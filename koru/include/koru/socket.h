@@ -5,6 +5,8 @@
 #pragma once
 
 #include "detail/winapi.h"
+#include "file.h"
+#include <cstdint>
 
 #include "detail/win_macros_begin.inl"
 
@@ -16,26 +18,64 @@ struct inet_info {
     int family, socktype, protocol;
 };
 
+enum class socket_role { none, bind, connect, listen };
+
+/// @brief The room AcceptEx needs for each of the local and remote addresses of a connection, which it can't be told not to store.
+constexpr uint32_t accept_addr_size = 28 /* sizeof(SOCKADDR_IN6) */ + 16;
+
+/// @brief A resolved remote address, so that connecting to it repeatedly takes no name lookup.
+struct endpoint {
+    inet_info ii;
+    int addrlen;
+    alignas(8) unsigned char addr[128]; // Holds a SOCKADDR_STORAGE
+};
+
+bool set_send_segment_size(SOCKET s, uint32_t size);
+
 class socket
 {
     template <bool, bool, std::size_t>
     friend class context;
 
-    socket(detail::SOCKET s) : s_{s} {}
+    socket(detail::SOCKET s) : native_handle{s} {}
 
   public:
     KORU_defctor(socket, = delete;);
     ~socket()
     {
-        [[maybe_unused]] const auto res = closesocket(s_);
+        [[maybe_unused]] const auto res = closesocket(native_handle);
         KORU_assert(res == 0);
     }
 
+    /// @brief Enables UDP segmentation offload: a send of more than the given size then goes out as several datagrams of that size, split by the NIC if it supports it or otherwise by the network stack, rather than each taking a call of its own.
+    /// @param size The payload size of each datagram but the last; 0 disables segmentation.
+    /// @return Whether the platform supports segmentation offload (Windows 10 version 2004 and later).
+    bool set_send_segment_size(const uint32_t size)
+    {
+        return detail::set_send_segment_size(native_handle, size);
+    }
+
+    /// @return The class of the I/Os on *this, as set by context::set_io_priority().
+    [[nodiscard]] io_priority priority() const noexcept { return priority_; }
+
+    /// @brief This is the WinSock handle representing the socket.
+    const detail::SOCKET native_handle;
+
   private:
-    detail::SOCKET s_;
+    io_priority priority_ = io_priority::normal;
+#pragma warning(suppress : 4820) /* padding added after data member */
 };
 } // namespace detail
 
+/// @brief A buffer for one datagram of a batched transfer.
+struct msg_buf {
+    void *data;
+    uint32_t size;       // Capacity of data in bytes
+    uint32_t nbytes = 0; // Set to the number of bytes transferred
+    bool truncated  = false; // Set if a datagram received didn't fit
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+
 static constexpr inline detail::inet_info //
     tcp{AF_UNSPEC, SOCK_STREAM, IPPROTO_TCP},
     tcp4{AF_INET, SOCK_STREAM, IPPROTO_TCP},
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "detail/frame_pool.h"
 #include "detail/utils.h"
+#include <bit>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
 
 namespace koru
 {
@@ -14,7 +19,7 @@ namespace detail
 template <class T, class Task>
 class sync_pointer
 {
-    template <class>
+    template <class, bool>
     friend class sync_task;
 
     using ex_ptr = std::exception_ptr;
@@ -22,7 +27,7 @@ class sync_pointer
 
     template <class>
     struct storage {
-        template <class>
+        template <class, bool>
         friend class sync_task;
         friend class sync_pointer;
         /// @brief Forms a reference to the coroutine result. Rethrows any stored exception.
@@ -38,6 +43,7 @@ class sync_pointer
             return *std::bit_cast<T *>(&buf);
         }
         T &await_resume() { return storage::get(); }
+        constexpr bool ready() const noexcept { return s != status::noinit; }
         ~storage()
         {
             if (s == status::value) [[likely]]
@@ -53,7 +59,7 @@ class sync_pointer
 
     template <>
     struct storage<void> {
-        template <class>
+        template <class, bool>
         friend class sync_task;
         friend class sync_pointer;
         /// @brief Rethrows any stored exception.
@@ -64,11 +70,24 @@ class sync_pointer
                 std::rethrow_exception(static_cast<ex_ptr &&>(ep));
         }
         void await_resume() { storage::get(); }
+        constexpr bool ready() const noexcept { return done; }
         ex_ptr ep{};
         std::coroutine_handle<> ch{};
+        bool done = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
     };
 
   public:
+    /// @brief Takes the frame of the coroutine from the frame pool of the thread starting it, so that steady-state tasks take no heap allocation.
+    static void *operator new(const std::size_t n)
+    {
+        return frame_pool::allocate(n);
+    }
+    static void operator delete(void *const p, const std::size_t n) noexcept
+    {
+        frame_pool::deallocate(p, n);
+    }
+
     constexpr Task get_return_object() noexcept { return {pstore}; }
     constexpr std::suspend_never initial_suspend() const noexcept { return {}; }
     constexpr auto final_suspend() const noexcept
@@ -79,10 +98,9 @@ class sync_pointer
             KORU_defctor(R, = delete;);
             bool await_suspend(std::coroutine_handle<>) noexcept
             {
-                if (store.ch) { // Resume awaiter
-                    store.ch.resume();
-                    KORU_dbg(store.ch = {});
-                }
+                // Resume awaiter; it may destroy the store before returning
+                if (store.ch)
+                    std::exchange(store.ch, {}).resume();
                 return false;
             }
         };
@@ -91,11 +109,15 @@ class sync_pointer
 
     void unhandled_exception() noexcept
     {
-        if constexpr (!std::is_void_v<T>) {
+        if constexpr (Task::nothrow)
+            std::terminate();
+        else if constexpr (!std::is_void_v<T>) {
             new (&pstore->buf) std::exception_ptr{std::current_exception()};
             pstore->s = status::error;
-        } else
-            pstore->ep = std::current_exception();
+        } else {
+            pstore->ep   = std::current_exception();
+            pstore->done = true;
+        }
     }
 
   private:
@@ -104,10 +126,12 @@ class sync_pointer
 
 /// @brief Models a synchronously performed task (e.g., no race conditions can occur in the accessing of this object).
 /// @tparam T The type of object returned from the coroutine.
-template <class T>
-class sync_task : public sync_pointer<T, sync_task<T>>::template storage<T>
+/// @tparam Nothrow Whether an exception escaping the coroutine terminates the program rather than being stored, which spares allocating an exception_ptr; see nothrow_task.
+template <class T, bool Nothrow = false>
+class sync_task
+    : public sync_pointer<T, sync_task<T, Nothrow>>::template storage<T>
 {
-    using base    = sync_pointer<T, sync_task<T>>;
+    using base    = sync_pointer<T, sync_task<T, Nothrow>>;
     using storage = base::template storage<T>;
     friend class base;
 
@@ -118,12 +142,11 @@ class sync_task : public sync_pointer<T, sync_task<T>>::template storage<T>
     }
 
   public:
+    static constexpr bool nothrow = Nothrow;
+
     KORU_defctor(sync_task, = delete;);
 
-    constexpr bool await_ready() noexcept
-    {
-        return storage::s != base::status::noinit;
-    }
+    constexpr bool await_ready() noexcept { return storage::ready(); }
     constexpr void await_suspend(std::coroutine_handle<> h) { storage::ch = h; }
 
     template <class>
@@ -147,11 +170,58 @@ class sync_task : public sync_pointer<T, sync_task<T>>::template storage<T>
 
     template <>
     struct promise<void> : base {
-        constexpr void return_void() noexcept {}
+        constexpr void return_void() noexcept { base::pstore->done = true; }
     };
 
     using promise_type = promise<T>;
 };
+
+//
+// DETACHED TASK : Fire-and-forget coroutine that frees itself on completion
+//
+
+class detached
+{
+  public:
+    struct promise_type {
+        static void *operator new(const std::size_t n)
+        {
+            return detail::frame_pool::allocate(n);
+        }
+        static void operator delete(void *const p, const std::size_t n) noexcept
+        {
+            detail::frame_pool::deallocate(p, n);
+        }
+
+        constexpr detached get_return_object() const noexcept { return {}; }
+        constexpr std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+        constexpr std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+        constexpr void return_void() const noexcept {}
+        [[noreturn]] void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+/// @brief Runs a task without anyone awaiting it; the task is kept alive until it completes. An exception escaping the task terminates the program.
+/// @param f A callable returning the awaitable to run, e.g., a sync_task.
+template <class F>
+detached spawn(F f)
+{
+    co_await f();
+}
+
+/// @brief A sync_task for error paths free of exceptions, e.g., awaiting the try_ variants of I/Os.
+template <class T>
+using nothrow_task = sync_task<T, true>;
 } // namespace detail
+using detail::nothrow_task;
 using detail::sync_task;
 } // namespace koru
\ No newline at end of file
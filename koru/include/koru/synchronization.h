@@ -0,0 +1,311 @@
+//
+// SYNCHRONIZATION : Semaphore, mutex and event suspending coroutines
+//
+
+#pragma once
+
+#include "detail/waiters.h"
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace koru
+{
+template <bool Atomic>
+class async_mutex;
+
+/// @brief A counting semaphore whose acquirers suspend rather than block while no permit is left, getting permits in the order they asked for them. A suspended coroutine gets resumed by the context it awaited through.
+/// @tparam Atomic Whether coroutines running on several threads may use the semaphore at once, each awaiting through a context of its own. Such contexts need AtomicIos set, as well as AsyncIos to notice resumptions while waiting for I/O.
+template <bool Atomic = false>
+class async_semaphore
+    : std::conditional_t<Atomic, detail::lockable, detail::empty>
+{
+    friend class async_mutex<Atomic>;
+
+    template <class Ctx>
+    class acquire_task : detail::waiter
+    {
+        friend class async_semaphore;
+        friend class async_mutex<Atomic>;
+
+      protected:
+        KORU_inline acquire_task(async_semaphore &s, Ctx &ctx) noexcept
+            : detail::waiter{ctx}, s_{s}
+        {
+        }
+
+      public:
+        KORU_defctor(acquire_task, = delete;);
+
+        bool await_ready() noexcept
+        {
+            if constexpr (Atomic)
+                return false;
+            else
+                return s_.try_acquire();
+        }
+        bool await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            this->h = h;
+            return s_.acquire_or_wait(*this);
+        }
+        constexpr void await_resume() const noexcept {}
+
+      private:
+        async_semaphore &s_;
+    };
+
+  public:
+    /// @param permits The number of permits initially available.
+    [[nodiscard]] explicit async_semaphore(const std::size_t permits) noexcept
+        : count_{permits}
+    {
+    }
+    KORU_defctor(async_semaphore, = delete;);
+
+    /// @brief Takes a permit, suspending until one is available.
+    /// @param ctx The context to resume the awaiting coroutine through if it has to suspend.
+    /// @return Task object; must be awaited on immediately.
+    template <class Ctx>
+    [[nodiscard]] KORU_inline acquire_task<Ctx> acquire(Ctx &ctx) noexcept
+    {
+        return {*this, ctx};
+    }
+
+    /// @brief Takes a permit if one is available and no coroutine is waiting for one.
+    /// @return Whether a permit got taken.
+    [[nodiscard]] bool try_acquire() noexcept
+    {
+        const auto l = lock();
+        if (!count_)
+            return false;
+        --count_;
+        return true;
+    }
+
+    /// @brief Returns permits, handing them to the longest waiting coroutines first.
+    /// @param n The number of permits to return.
+    void release(std::size_t n = 1) noexcept
+    {
+        detail::waiter_queue woken;
+        {
+            const auto l = lock();
+            for (; n; --n) {
+                const auto w = waiters_.pop();
+                if (!w)
+                    break;
+                woken.push(*w);
+            }
+            count_ += n;
+        }
+        detail::wake_all(woken.take_all());
+    }
+
+    /// @return The number of permits available.
+    [[nodiscard]] std::size_t available() noexcept
+    {
+        const auto l = lock();
+        return count_;
+    }
+
+  private:
+    KORU_inline auto lock() noexcept
+    {
+        if constexpr (Atomic)
+            return detail::lock<false>{this->srwl};
+        else
+            return detail::empty{};
+    }
+
+    /// @return Whether the waiter got queued to wait.
+    bool acquire_or_wait(detail::waiter &w) noexcept
+    {
+        const auto l = lock();
+        // Permits are handed to waiters directly, so none is left while any
+        // coroutine waits
+        if (Atomic && count_) {
+            --count_;
+            return false;
+        }
+        waiters_.push(w);
+        return true;
+    }
+
+    std::size_t count_;
+    detail::waiter_queue waiters_;
+};
+
+/// @brief A mutex whose lockers suspend rather than block while it's locked, acquiring it in the order they asked for it. A suspended coroutine gets resumed by the context it awaited through. Unlike SRWLOCKs, the mutex may be held across suspension points and unlocked by another thread than the one that locked it.
+/// @tparam Atomic Whether coroutines running on several threads may use the mutex at once; see async_semaphore.
+template <bool Atomic = false>
+class async_mutex
+{
+  public:
+    /// @brief Owns a locked mutex, unlocking it on destruction.
+    class [[nodiscard]] lock_guard
+    {
+      public:
+        explicit lock_guard(async_mutex &m) noexcept : m_{&m} {}
+        lock_guard(lock_guard &&other) noexcept
+            : m_{std::exchange(other.m_, nullptr)}
+        {
+        }
+        lock_guard &operator=(lock_guard &&) = delete;
+        ~lock_guard()
+        {
+            if (m_)
+                m_->unlock();
+        }
+
+      private:
+        async_mutex *m_;
+    };
+
+  private:
+    template <class Ctx>
+    using lock_task = async_semaphore<Atomic>::template acquire_task<Ctx>;
+
+    template <class Ctx>
+    class scoped_lock_task : public lock_task<Ctx>
+    {
+        friend class async_mutex;
+
+        KORU_inline scoped_lock_task(async_mutex &m, Ctx &ctx) noexcept
+            : lock_task<Ctx>{m.sem_, ctx}, m_{m}
+        {
+        }
+
+      public:
+        KORU_defctor(scoped_lock_task, = delete;);
+
+        lock_guard await_resume() const noexcept { return lock_guard{m_}; }
+
+      private:
+        async_mutex &m_;
+    };
+
+  public:
+    KORU_defctor(async_mutex, noexcept : sem_{1}{});
+
+    /// @brief Locks the mutex, suspending while it's locked.
+    /// @param ctx The context to resume the awaiting coroutine through if it has to suspend.
+    /// @return Task object; must be awaited on immediately.
+    template <class Ctx>
+    [[nodiscard]] KORU_inline lock_task<Ctx> lock(Ctx &ctx) noexcept
+    {
+        return {sem_, ctx};
+    }
+
+    /// @brief Like lock(), but the lock is owned by the resulting guard.
+    /// @return Task object resulting in the guard; must be awaited on immediately.
+    template <class Ctx>
+    [[nodiscard]] KORU_inline scoped_lock_task<Ctx>
+    scoped_lock(Ctx &ctx) noexcept
+    {
+        return {*this, ctx};
+    }
+
+    /// @return Whether the mutex got locked; fails if it's locked or being waited for.
+    [[nodiscard]] bool try_lock() noexcept { return sem_.try_acquire(); }
+
+    /// @brief Unlocks the mutex, handing it to the longest waiting coroutine if any.
+    void unlock() noexcept { sem_.release(); }
+
+  private:
+    async_semaphore<Atomic> sem_;
+};
+
+/// @brief A manual-reset event whose waiters suspend rather than block until it's set, upon which they're all resumed. A suspended coroutine gets resumed by the context it awaited through.
+/// @tparam Atomic Whether coroutines running on several threads may use the event at once; see async_semaphore.
+template <bool Atomic = false>
+class async_event : std::conditional_t<Atomic, detail::lockable, detail::empty>
+{
+    template <class Ctx>
+    class wait_task : detail::waiter
+    {
+        friend class async_event;
+
+        KORU_inline wait_task(async_event &e, Ctx &ctx) noexcept
+            : detail::waiter{ctx}, e_{e}
+        {
+        }
+
+      public:
+        KORU_defctor(wait_task, = delete;);
+
+        bool await_ready() const noexcept
+        {
+            if constexpr (Atomic)
+                return false;
+            else
+                return e_.set_;
+        }
+        bool await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            this->h      = h;
+            const auto l = e_.lock();
+            if (Atomic && e_.set_)
+                return false;
+            e_.waiters_.push(*this);
+            return true;
+        }
+        constexpr void await_resume() const noexcept {}
+
+      private:
+        async_event &e_;
+    };
+
+  public:
+    /// @param set Whether the event is initially set.
+    [[nodiscard]] explicit async_event(const bool set) noexcept : set_{set} {}
+    KORU_defctor(async_event, noexcept : set_{false}{});
+
+    /// @brief Waits for the event to be set.
+    /// @param ctx The context to resume the awaiting coroutine through if it has to suspend.
+    /// @return Task object; must be awaited on immediately.
+    template <class Ctx>
+    [[nodiscard]] KORU_inline wait_task<Ctx> wait(Ctx &ctx) noexcept
+    {
+        return {*this, ctx};
+    }
+
+    /// @brief Sets the event, resuming all its waiters.
+    void set() noexcept
+    {
+        detail::waiter *w;
+        {
+            const auto l = lock();
+            set_         = true;
+            w            = waiters_.take_all();
+        }
+        detail::wake_all(w);
+    }
+
+    /// @brief Resets the event, so that coroutines waiting for it from now on suspend.
+    void reset() noexcept
+    {
+        const auto l = lock();
+        set_         = false;
+    }
+
+    /// @return Whether the event is set.
+    [[nodiscard]] bool is_set() noexcept
+    {
+        const auto l = lock();
+        return set_;
+    }
+
+  private:
+    KORU_inline auto lock() noexcept
+    {
+        if constexpr (Atomic)
+            return detail::lock<false>{this->srwl};
+        else
+            return detail::empty{};
+    }
+
+    detail::waiter_queue waiters_;
+    bool set_;
+#pragma warning(suppress : 4820) /* padding added after data member */
+};
+} // namespace koru
\ No newline at end of file
@@ -0,0 +1,177 @@
+//
+// TASK GROUP : Structured concurrency with a bound on running tasks
+//
+
+#pragma once
+
+#include "context.h"
+#include "detail/waiters.h"
+#include "sync_task.h"
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+namespace koru
+{
+/// @brief Runs tasks concurrently, at most a given number at once, and lets a coroutine wait for all of them. Tasks only get created once they can run, so a batch of any size keeps a bounded number of frames alive. The first exception escaping a task cancels the group: no more tasks get started, and the running ones can stop early by checking cancelled(). Must only be used from the thread running its context.
+/// @tparam Ctx The type of the context the tasks run on.
+template <class Ctx>
+class task_group
+{
+    // A spawner waiting for a task to finish
+    struct spawner : detail::waiter {
+        using detail::waiter::waiter;
+
+        bool reserved = false;
+#pragma warning(suppress : 4820) /* padding added after data member */
+    };
+
+    template <class F>
+    class spawn_task : spawner
+    {
+        friend class task_group;
+
+        KORU_inline spawn_task(task_group &g, F &&f) noexcept(
+            std::is_nothrow_move_constructible_v<F>)
+            : spawner{g.ctx_}, g_{g}, f_{static_cast<F &&>(f)}
+        {
+        }
+
+      public:
+        KORU_defctor(spawn_task, = delete;);
+
+        bool await_ready()
+        {
+            if (g_.ep_)
+                return true;
+            if (g_.running_ == g_.max_)
+                return false;
+            ++g_.running_;
+            this->reserved = true;
+            return true;
+        }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            this->h = h;
+            g_.spawners_.push(*this);
+        }
+        bool await_resume()
+        {
+            if (!this->reserved)
+                return false;
+            // The group may have been cancelled since the slot got reserved
+            if (g_.ep_) {
+                g_.finish();
+                return false;
+            }
+            g_.start(static_cast<F &&>(f_));
+            return true;
+        }
+
+      private:
+        task_group &g_;
+        F f_;
+    };
+
+    class join_task : detail::ready_node
+    {
+        friend class task_group;
+
+        KORU_inline join_task(task_group &g) noexcept
+            : detail::ready_node{}, g_{g}
+        {
+        }
+
+      public:
+        KORU_defctor(join_task, = delete;);
+
+        bool await_ready() const noexcept { return !g_.running_; }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            this->h    = h;
+            g_.joiner_ = this;
+        }
+        void await_resume() const
+        {
+            if (g_.ep_) [[unlikely]]
+                std::rethrow_exception(std::exchange(g_.ep_, nullptr));
+        }
+
+      private:
+        task_group &g_;
+    };
+
+  public:
+    /// @param ctx The context the tasks run on.
+    /// @param max_concurrency The greatest number of tasks running at once.
+    [[nodiscard]] task_group(Ctx &ctx, const std::size_t max_concurrency)
+        : ctx_{ctx}, max_{max_concurrency}
+    {
+        KORU_assert(max_);
+    }
+    KORU_defctor(task_group, = delete;);
+    ~task_group() { KORU_assert(!running_); }
+
+    /// @brief Starts a task once fewer than max_concurrency tasks are running, suspending until then.
+    /// @param f A callable returning the task to run, e.g., a sync_task; only called once the task can run.
+    /// @return Task object resulting in whether the task got started, which it doesn't once the group has been cancelled; must be awaited on immediately.
+    template <class F>
+    [[nodiscard]] KORU_inline spawn_task<F> spawn(F f) noexcept(
+        std::is_nothrow_move_constructible_v<F>)
+    {
+        return {*this, static_cast<F &&>(f)};
+    }
+
+    /// @brief Waits for all tasks started so far to finish. Must be awaited on by one coroutine at a time, and before the group gets destroyed.
+    /// @return Task object rethrowing the exception that cancelled the group, if any, which uncancels it; must be awaited on immediately.
+    [[nodiscard]] KORU_inline join_task join() noexcept { return {*this}; }
+
+    /// @return Whether a task has failed since the last join.
+    [[nodiscard]] bool cancelled() const noexcept { return ep_ != nullptr; }
+
+    /// @return The number of tasks running.
+    [[nodiscard]] std::size_t running() const noexcept { return running_; }
+
+  private:
+    template <class F>
+    void start(F &&f)
+    {
+        detail::spawn([this, f = static_cast<F &&>(f)]() mutable {
+            return run(f);
+        });
+    }
+
+    template <class F>
+    sync_task<void> run(F &f)
+    {
+        try {
+            co_await f();
+        } catch (...) {
+            if (!ep_)
+                ep_ = std::current_exception();
+        }
+        finish();
+    }
+
+    /// @brief Frees the slot of a task, handing it to the longest waiting spawner or waking them all once the group is cancelled.
+    void finish() noexcept
+    {
+        if (ep_) {
+            detail::wake_all(spawners_.take_all());
+        } else if (const auto w = spawners_.pop()) {
+            static_cast<spawner *>(w)->reserved = true;
+            w->wake();
+            return;
+        }
+        if (!--running_ && joiner_)
+            ctx_.post(*std::exchange(joiner_, nullptr));
+    }
+
+    Ctx &ctx_;
+    std::size_t max_, running_ = 0;
+    detail::waiter_queue spawners_;
+    detail::ready_node *joiner_ = nullptr;
+    std::exception_ptr ep_;
+};
+} // namespace koru
\ No newline at end of file
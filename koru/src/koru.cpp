@@ -1,10 +1,17 @@
 ﻿#include "../include/koru/detail/utils.h"
 #include "../include/koru/detail/winapi.h"
+#include "../include/koru/file.h"
+#include "../include/koru/offload.h"
+#include "../include/koru/socket.h"
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
 #include <system_error>
+#include <vector>
 
-#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
-#define _WIN32_WINNT 0x0600 /* minimum for SRWLs */
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0601
+#define _WIN32_WINNT 0x0601 /* minimum for SRWLs and processor groups */
 #endif
 
 #pragma warning(push, 3)
@@ -12,10 +19,18 @@
 #include <WS2tcpip.h>
 #include <WinSock2.h>
 #include <Windows.h>
+#include <MSWSock.h>
 #include <iphlpapi.h>
+#include <mstcpip.h>
+#include <winioctl.h>
 #pragma warning(pop)
 
 #pragma comment(lib, "Ws2_32.lib")
+#pragma comment(lib, "Mswsock.lib")
+
+#ifndef UDP_SEND_MSG_SIZE
+#define UDP_SEND_MSG_SIZE 2 /* missing from SDKs before Windows 10 2004 */
+#endif
 
 const std::error_category &wsa_category() noexcept;
 
@@ -31,9 +46,34 @@ void throw_last_wsa_error()
     throw std::system_error{static_cast<int>(WSAGetLastError()),
                             wsa_category()};
 }
+std::error_code winapi_error(const DWORD code) noexcept
+{
+    return {static_cast<int>(code), std::system_category()};
+}
+std::error_code wsa_error(const int code) noexcept
+{
+    return {code, wsa_category()};
+}
+
+DWORD overlapped_error(const HANDLE h, OVERLAPPED &ol) noexcept
+{
+    DWORD n;
+    return GetOverlappedResult(h, std::bit_cast<::OVERLAPPED *>(&ol), &n,
+                               false)
+               ? 0
+               : GetLastError();
+}
+int overlapped_wsa_error(const SOCKET s, OVERLAPPED &ol) noexcept
+{
+    DWORD n, flags;
+    return WSAGetOverlappedResult(s, std::bit_cast<::OVERLAPPED *>(&ol), &n,
+                                  false, &flags)
+               ? 0
+               : WSAGetLastError();
+}
 
 SOCKET create_socket(const wchar_t *node, const wchar_t *service,
-                     const ADDRINFOW &hints)
+                     const ADDRINFOW &hints, const socket_role role)
 {
     ::ADDRINFOW *res;
     if (GetAddrInfoW(node, service, std::bit_cast<const ::ADDRINFOW *>(&hints),
@@ -44,12 +84,561 @@ SOCKET create_socket(const wchar_t *node, const wchar_t *service,
         const auto sock =
             WSASocketW(res->ai_family, res->ai_socktype, res->ai_protocol,
                        nullptr, 0, WSA_FLAG_OVERLAPPED);
-        if (sock != INVALID_SOCKET)
-            return {sock};
+        if (sock == INVALID_SOCKET)
+            continue;
+        const auto addrlen = static_cast<int>(res->ai_addrlen);
+        // Datagram sockets don't block so that transfer_available() can
+        // drain them; overlapped operations are unaffected
+        u_long nonblocking = res->ai_socktype == SOCK_DGRAM;
+        if (((role == socket_role::bind || role == socket_role::listen) &&
+             ::bind(sock, res->ai_addr, addrlen) != 0) ||
+            (role == socket_role::listen && ::listen(sock, SOMAXCONN) != 0) ||
+            (role == socket_role::connect &&
+             ::connect(sock, res->ai_addr, addrlen) != 0) ||
+            ioctlsocket(sock, FIONBIO, &nonblocking) != 0) {
+            // Try the next address, keeping the error in case there's none
+            const auto err = WSAGetLastError();
+            closesocket(sock);
+            WSASetLastError(err);
+            continue;
+        }
+        return sock;
     } while ((res = res->ai_next));
     throw_last_wsa_error();
 }
 
+std::size_t transfer_available(const SOCKET s, msg_buf *const msgs,
+                               const std::size_t n, const bool send,
+                               int &err) noexcept
+{
+    err           = 0;
+    std::size_t i = 0;
+    for (; i < n; ++i) {
+        ::WSABUF wb{msgs[i].size, static_cast<char *>(msgs[i].data)};
+        DWORD nbytes, flags = 0;
+        msgs[i].truncated = false;
+        if ((send ? ::WSASend(s, &wb, 1, &nbytes, 0, nullptr, nullptr)
+                  : ::WSARecv(s, &wb, 1, &nbytes, &flags, nullptr,
+                              nullptr)) != 0) {
+            const auto e = WSAGetLastError();
+            if (!send && e == WSAEMSGSIZE) {
+                // The datagram got cut to the size of the buffer and the
+                // rest of it discarded; report it rather than lose it
+                msgs[i].nbytes    = msgs[i].size;
+                msgs[i].truncated = true;
+                continue;
+            }
+            if (e != WSAEWOULDBLOCK)
+                err = e;
+            break;
+        }
+        msgs[i].nbytes = nbytes;
+    }
+    return i;
+}
+
+SOCKET create_accept_socket(const SOCKET listener)
+{
+    WSAPROTOCOL_INFOW pi;
+    int len = sizeof(pi);
+    if (getsockopt(listener, SOL_SOCKET, SO_PROTOCOL_INFOW,
+                   reinterpret_cast<char *>(&pi), &len) != 0)
+        throw_last_wsa_error();
+    const auto sock = WSASocketW(pi.iAddressFamily, pi.iSocketType,
+                                 pi.iProtocol, nullptr, 0, WSA_FLAG_OVERLAPPED);
+    if (sock == INVALID_SOCKET)
+        throw_last_wsa_error();
+    return sock;
+}
+
+void finish_accept(const SOCKET listener, const SOCKET s)
+{
+    if (setsockopt(s, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT,
+                   reinterpret_cast<const char *>(&listener),
+                   sizeof(listener)) != 0)
+        throw_last_wsa_error();
+}
+
+bool at_stream_end(const SOCKET s, int &err) noexcept
+{
+    // Only called once something is pending, so the peek doesn't block
+    char c;
+    const auto n = ::recv(s, &c, 1, MSG_PEEK);
+    err          = n == SOCKET_ERROR ? WSAGetLastError() : 0;
+    return n == 0;
+}
+
+endpoint resolve(const wchar_t *node, const wchar_t *service,
+                 const ADDRINFOW &hints)
+{
+    ::ADDRINFOW *res;
+    if (GetAddrInfoW(node, service, std::bit_cast<const ::ADDRINFOW *>(&hints),
+                     &res) != 0)
+        throw_last_wsa_error();
+    KORU_defer[=] { FreeAddrInfoW(res); };
+    static_assert(sizeof(endpoint::addr) >= sizeof(::SOCKADDR_STORAGE));
+    endpoint ep{.ii      = {res->ai_family, res->ai_socktype, res->ai_protocol},
+                .addrlen = static_cast<int>(res->ai_addrlen)};
+    std::memcpy(&ep.addr[0], res->ai_addr, res->ai_addrlen);
+    return ep;
+}
+
+SOCKET create_connect_socket(const endpoint &ep)
+{
+    const auto sock = WSASocketW(ep.ii.family, ep.ii.socktype, ep.ii.protocol,
+                                 nullptr, 0, WSA_FLAG_OVERLAPPED);
+    if (sock == INVALID_SOCKET)
+        throw_last_wsa_error();
+    // ConnectEx only takes bound sockets
+    ::SOCKADDR_STORAGE any{};
+    any.ss_family = static_cast<ADDRESS_FAMILY>(ep.ii.family);
+    if (::bind(sock, reinterpret_cast<const ::sockaddr *>(&any),
+               ep.ii.family == AF_INET6 ? sizeof(::SOCKADDR_IN6)
+                                        : sizeof(::SOCKADDR_IN)) != 0) {
+        const auto err = WSAGetLastError();
+        closesocket(sock);
+        throw std::system_error{wsa_error(err)};
+    }
+    return sock;
+}
+
+void finish_connect(const SOCKET s)
+{
+    if (setsockopt(s, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, nullptr, 0) != 0)
+        throw_last_wsa_error();
+}
+
+bool is_alive(const SOCKET s) noexcept
+{
+    // An idle connection has nothing to read: readability means the peer
+    // closed it or sent something unsolicited, either way making it unusable
+    ::WSAPOLLFD pfd{.fd = s, .events = POLLRDNORM};
+    return WSAPoll(&pfd, 1, 0) == 0;
+}
+
+void cancel_io(const SOCKET s) noexcept
+{
+    CancelIoEx(reinterpret_cast<HANDLE>(s), nullptr);
+}
+
+int rss_processor(const SOCKET s) noexcept
+{
+    SOCKET_PROCESSOR_AFFINITY spa;
+    DWORD n;
+    if (WSAIoctl(s, SIO_QUERY_RSS_PROCESSOR_INFO, nullptr, 0, &spa,
+                 sizeof(spa), &n, nullptr, nullptr) != 0)
+        return -1;
+    // Number processors consecutively across groups, as pin_thread() does
+    unsigned cpu = spa.Processor.Number;
+    for (WORD group = 0; group < spa.Processor.Group; ++group)
+        cpu += GetActiveProcessorCount(group);
+    return static_cast<int>(cpu);
+}
+
+bool set_send_segment_size(const SOCKET s, const uint32_t size)
+{
+    const DWORD v = size;
+    if (setsockopt(s, IPPROTO_UDP, UDP_SEND_MSG_SIZE,
+                   reinterpret_cast<const char *>(&v), sizeof(v)) == 0)
+        return true;
+    // Older versions of Windows don't know the option
+    if (const auto err = WSAGetLastError();
+        err == WSAENOPROTOOPT || err == WSAEINVAL)
+        return false;
+    throw_last_wsa_error();
+}
+
+file_stat get_file_stat(const HANDLE h)
+{
+    BY_HANDLE_FILE_INFORMATION fi;
+    if (!GetFileInformationByHandle(h, &fi))
+        throw_last_winapi_error();
+    constexpr auto u64 = [](const DWORD hi, const DWORD lo) {
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+    };
+    return {.size            = u64(fi.nFileSizeHigh, fi.nFileSizeLow),
+            .last_write_time = u64(fi.ftLastWriteTime.dwHighDateTime,
+                                   fi.ftLastWriteTime.dwLowDateTime),
+            .file_id         = u64(fi.nFileIndexHigh, fi.nFileIndexLow),
+            .volume_serial   = fi.dwVolumeSerialNumber,
+            .links           = fi.nNumberOfLinks,
+            .attributes      = fi.dwFileAttributes};
+}
+
+void flush(const HANDLE h, const bool data_only)
+{
+    // A data-only flush is exposed by ntdll only (from Windows 10 1709 on)
+    if (data_only) {
+        struct io_status_block {
+            union {
+                LONG Status;
+                PVOID Pointer;
+            };
+            ULONG_PTR Information;
+        };
+        using nt_flush_t =
+            LONG(NTAPI *)(HANDLE, ULONG, PVOID, ULONG, io_status_block *);
+        using to_dos_t             = ULONG(NTAPI *)(LONG);
+        static const auto ntdll    = GetModuleHandleW(L"ntdll.dll");
+        static const auto nt_flush = std::bit_cast<nt_flush_t>(
+            GetProcAddress(ntdll, "NtFlushBuffersFileEx"));
+        static const auto to_dos   = std::bit_cast<to_dos_t>(
+            GetProcAddress(ntdll, "RtlNtStatusToDosError"));
+        if (nt_flush && to_dos) {
+            constexpr ULONG flush_flags_file_data_sync_only = 0x4;
+            constexpr LONG status_pending                   = 0x103;
+            io_status_block iosb{};
+            iosb.Status = status_pending;
+            auto status = nt_flush(h, flush_flags_file_data_sync_only,
+                                   nullptr, 0, &iosb);
+            if (status == status_pending) {
+                // The file's opened for overlapped I/O, so the flush may
+                // still be ongoing; iosb mustn't go out of scope before it
+                // completes. Without an event to pass, the handle gets
+                // signaled once it does, or once another I/O on the file
+                // does, hence the loop.
+                const std::atomic_ref<LONG> done_status{iosb.Status};
+                while ((status = done_status.load()) == status_pending) {
+                    [[maybe_unused]] const auto res =
+                        WaitForSingleObject(h, INFINITE);
+                    KORU_assert(res != WAIT_FAILED);
+                }
+            }
+            if (status < 0) {
+                SetLastError(to_dos(status));
+                throw_last_winapi_error();
+            }
+            return;
+        }
+    }
+    if (!FlushFileBuffers(h))
+        throw_last_winapi_error();
+}
+
+void allocate(const HANDLE h, const uint64_t offset, const uint64_t nbytes)
+{
+    FILE_STANDARD_INFO si;
+    if (!GetFileInformationByHandleEx(h, FileStandardInfo, &si, sizeof(si)))
+        throw_last_winapi_error();
+    const auto end = static_cast<LONGLONG>(offset + nbytes);
+    if (si.AllocationSize.QuadPart < end) {
+        FILE_ALLOCATION_INFO ai;
+        ai.AllocationSize.QuadPart = end;
+        if (!SetFileInformationByHandle(h, FileAllocationInfo, &ai,
+                                        sizeof(ai)))
+            throw_last_winapi_error();
+    }
+    if (si.EndOfFile.QuadPart < end) {
+        FILE_END_OF_FILE_INFO ei;
+        ei.EndOfFile.QuadPart = end;
+        if (!SetFileInformationByHandle(h, FileEndOfFileInfo, &ei, sizeof(ei)))
+            throw_last_winapi_error();
+    }
+}
+
+bool set_io_priority_hint(const HANDLE h, const io_priority p) noexcept
+{
+    // The hints above normal are reserved to the system
+    FILE_IO_PRIORITY_HINT_INFO pi;
+    pi.PriorityHint =
+        p == io_priority::bulk ? IoPriorityHintLow : IoPriorityHintNormal;
+    return SetFileInformationByHandle(h, FileIoPriorityHintInfo, &pi,
+                                      sizeof(pi));
+}
+
+// Block cloning (ReFS, Windows Server 2016 on) is declared by the SDK only for
+// newer targets than the one set above
+constexpr DWORD get_integrity_information = CTL_CODE(
+    FILE_DEVICE_FILE_SYSTEM, 159, METHOD_BUFFERED, FILE_ANY_ACCESS);
+constexpr DWORD duplicate_extents_to_file = CTL_CODE(
+    FILE_DEVICE_FILE_SYSTEM, 209, METHOD_BUFFERED, FILE_WRITE_ACCESS);
+struct integrity_information {
+    WORD ChecksumAlgorithm;
+    WORD Reserved;
+    DWORD Flags;
+    DWORD ChecksumChunkSizeInBytes;
+    DWORD ClusterSizeInBytes;
+};
+struct duplicate_extents_data {
+    HANDLE FileHandle;
+    LARGE_INTEGER SourceFileOffset;
+    LARGE_INTEGER TargetFileOffset;
+    LARGE_INTEGER ByteCount;
+};
+
+// Issues a control code on a handle opened for overlapped I/O, waiting for it
+static bool ioctl(const HANDLE h, const DWORD code, void *const in,
+                  const DWORD in_sz, void *const out, const DWORD out_sz,
+                  DWORD &ret) noexcept
+{
+    OVERLAPPED ol{};
+    ol.hEvent = CreateEventW(nullptr, true, false, nullptr);
+    if (!ol.hEvent)
+        return false;
+    KORU_defer[&] { CloseHandle(ol.hEvent); };
+    if (!DeviceIoControl(h, code, in, in_sz, out, out_sz, &ret, &ol) &&
+        GetLastError() != ERROR_IO_PENDING)
+        return false;
+    return GetOverlappedResult(h, &ol, &ret, true);
+}
+
+void set_size(const HANDLE h, const uint64_t size)
+{
+    FILE_END_OF_FILE_INFO ei;
+    ei.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFileInformationByHandle(h, FileEndOfFileInfo, &ei, sizeof(ei)))
+        throw_last_winapi_error();
+}
+
+void set_sparse(const HANDLE h)
+{
+    DWORD ret;
+    if (!ioctl(h, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, ret))
+        throw_last_winapi_error();
+}
+
+bool clone_file(const HANDLE src, const HANDLE dst, const uint64_t size)
+{
+    // Block cloning is supported by ReFS only, between files on the same
+    // volume, in whole clusters; failing any of these, the caller copies.
+    integrity_information ii;
+    DWORD ret;
+    if (!ioctl(src, get_integrity_information, nullptr, 0, &ii, sizeof(ii),
+               ret))
+        return false;
+    set_size(dst, size);
+    const uint64_t cluster = ii.ClusterSizeInBytes;
+    const auto end         = (size + cluster - 1) / cluster * cluster;
+    for (uint64_t off = 0; off < end;) {
+        // Each clone has to stay below 4 GiB
+        const auto n = std::min<uint64_t>(end - off, uint64_t{1} << 31);
+        duplicate_extents_data dd{};
+        dd.FileHandle                = src;
+        dd.SourceFileOffset.QuadPart = static_cast<LONGLONG>(off);
+        dd.TargetFileOffset.QuadPart = static_cast<LONGLONG>(off);
+        dd.ByteCount.QuadPart        = static_cast<LONGLONG>(n);
+        if (!ioctl(dst, duplicate_extents_to_file, &dd, sizeof(dd), nullptr, 0,
+                   ret))
+            return false;
+        off += n;
+    }
+    return true;
+}
+
+std::size_t allocated_ranges(const HANDLE h, const uint64_t offset,
+                             const uint64_t size, byte_range *const out,
+                             const std::size_t n)
+{
+    FILE_ALLOCATED_RANGE_BUFFER q;
+    q.FileOffset.QuadPart = static_cast<LONGLONG>(offset);
+    q.Length.QuadPart     = static_cast<LONGLONG>(size - offset);
+    static_assert(sizeof(byte_range) == sizeof(FILE_ALLOCATED_RANGE_BUFFER));
+    DWORD ret;
+    if (!ioctl(h, FSCTL_QUERY_ALLOCATED_RANGES, &q, sizeof(q), out,
+               static_cast<DWORD>(n * sizeof(byte_range)), ret)) {
+        const auto err = GetLastError();
+        if (err == ERROR_MORE_DATA)
+            return n;
+        if (err != ERROR_INVALID_FUNCTION && err != ERROR_NOT_SUPPORTED)
+            throw_last_winapi_error();
+        // File systems without sparse files have it all allocated
+        out[0] = {offset, size - offset};
+        return 1;
+    }
+    return ret / sizeof(byte_range);
+}
+
+HANDLE open_dir(const wchar_t *const path)
+{
+    const auto h = CreateFileW(
+        path, FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        throw_last_winapi_error();
+    return h;
+}
+
+bool read_dir(const HANDLE h, const std::wstring &dir, void *const buf,
+              const std::size_t nbytes, std::vector<dir_entry> &out)
+{
+    if (!GetFileInformationByHandleEx(h, FileFullDirectoryInfo, buf,
+                                      static_cast<DWORD>(nbytes))) {
+        if (GetLastError() == ERROR_NO_MORE_FILES)
+            return false;
+        throw_last_winapi_error();
+    }
+    for (auto p = static_cast<const char *>(buf);;) {
+        const auto &fi = *reinterpret_cast<const FILE_FULL_DIR_INFO *>(p);
+        const std::wstring_view name{fi.FileName,
+                                     fi.FileNameLength / sizeof(WCHAR)};
+        if (name != L"." && name != L"..") {
+            auto path = dir;
+            path += L'\\';
+            path += name;
+            out.push_back({
+                .path = std::move(path),
+                .size = static_cast<uint64_t>(fi.EndOfFile.QuadPart),
+                .last_write_time =
+                    static_cast<uint64_t>(fi.LastWriteTime.QuadPart),
+                .attributes = fi.FileAttributes,
+            });
+        }
+        if (!fi.NextEntryOffset)
+            return true;
+        p += fi.NextEntryOffset;
+    }
+}
+
+unsigned processor_count() noexcept
+{
+    return GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+}
+
+unsigned pin_thread(unsigned cpu)
+{
+    // Find the processor group the flat processor index belongs to
+    WORD group = 0;
+    for (const auto ngroups = GetActiveProcessorGroupCount(); group < ngroups;
+         ++group) {
+        const auto n = GetActiveProcessorCount(group);
+        if (cpu < n)
+            break;
+        cpu -= n;
+    }
+
+    GROUP_AFFINITY ga{};
+    ga.Group = group;
+    ga.Mask  = KAFFINITY{1} << cpu;
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &ga, nullptr))
+        throw_last_winapi_error();
+
+    PROCESSOR_NUMBER pn{};
+    pn.Group  = group;
+    pn.Number = static_cast<BYTE>(cpu);
+    USHORT node;
+    if (!GetNumaProcessorNodeEx(&pn, &node))
+        throw_last_winapi_error();
+    return node;
+}
+
+void *numa_alloc(const std::size_t nbytes, const unsigned node)
+{
+    const auto p = VirtualAllocExNuma(GetCurrentProcess(), nullptr, nbytes,
+                                      MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE,
+                                      node);
+    if (!p)
+        throw_last_winapi_error();
+    return p;
+}
+
+void numa_free(void *const p) noexcept
+{
+    [[maybe_unused]] const auto res = VirtualFree(p, 0, MEM_RELEASE);
+    KORU_assert(res != 0);
+}
+
+HANDLE start_timer(const HANDLE ev, const DWORD ms)
+{
+    HANDLE timer;
+    if (!CreateTimerQueueTimer(
+            &timer, nullptr,
+            [](const PVOID param, BOOLEAN) { ::SetEvent(param); }, ev, ms, 0,
+            WT_EXECUTEINTIMERTHREAD | WT_EXECUTEONLYONCE))
+        throw_last_winapi_error();
+    return timer;
+}
+
+void stop_timer(const HANDLE timer) noexcept
+{
+    [[maybe_unused]] const auto res =
+        DeleteTimerQueueTimer(nullptr, timer, INVALID_HANDLE_VALUE);
+    KORU_assert(res != 0);
+}
+
+#pragma region offload pool
+offload_pool::offload_pool(const offload_limits limits)
+    : max_queue_{limits.max_queue}
+{
+    threads_.reserve(limits.threads);
+    try {
+        for (std::size_t i = 0; i < limits.threads; ++i)
+            threads_.emplace_back([this] { work(); });
+    } catch (...) {
+        stop();
+        throw;
+    }
+}
+
+offload_pool::~offload_pool() { stop(); }
+
+void offload_pool::stop() noexcept
+{
+    {
+        const std::lock_guard l{m_};
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &t : threads_)
+        t.join();
+    threads_.clear();
+}
+
+bool offload_pool::submit(offload_job &job) noexcept
+{
+    {
+        const std::lock_guard l{m_};
+        if (depth_ >= max_queue_ || threads_.empty())
+            return false;
+        job.next = nullptr;
+        (tail_ ? tail_->next : head_) = &job;
+        tail_                         = &job;
+        ++stats_.submitted;
+        stats_.max_depth = std::max(stats_.max_depth, ++depth_);
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void offload_pool::count_inlined() noexcept
+{
+    const std::lock_guard l{m_};
+    ++stats_.inlined;
+}
+
+offload_stats offload_pool::stats() noexcept
+{
+    const std::lock_guard l{m_};
+    return stats_;
+}
+
+void offload_pool::work() noexcept
+{
+    for (;;) {
+        offload_job *job;
+        {
+            std::unique_lock l{m_};
+            cv_.wait(l, [&] { return head_ || stop_; });
+            if (!head_)
+                return;
+            job = head_;
+            if (!(head_ = job->next))
+                tail_ = nullptr;
+            --depth_;
+        }
+
+        // The awaiter may be gone as soon as the event is signaled
+        const auto ev = job->ev;
+        job->run(job);
+        {
+            const std::lock_guard l{m_};
+            ++stats_.completed;
+        }
+        ::SetEvent(ev);
+    }
+}
+#pragma endregion
+
 #pragma region WinAPI glue
 BOOL ReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
               LPDWORD lpNumberOfBytesRead, OVERLAPPED *lpOverlapped) noexcept
@@ -67,6 +656,58 @@ BOOL WriteFile(HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite,
                        std::bit_cast<::OVERLAPPED *>(lpOverlapped));
 }
 
+int WSARecv(SOCKET s, WSABUF *lpBuffers, DWORD dwBufferCount,
+            LPDWORD lpNumberOfBytesRecvd, LPDWORD lpFlags,
+            OVERLAPPED *lpOverlapped) noexcept
+{
+    return ::WSARecv(s, std::bit_cast<::WSABUF *>(lpBuffers), dwBufferCount,
+                     lpNumberOfBytesRecvd, lpFlags,
+                     std::bit_cast<::OVERLAPPED *>(lpOverlapped), nullptr);
+}
+int WSASend(SOCKET s, WSABUF *lpBuffers, DWORD dwBufferCount,
+            LPDWORD lpNumberOfBytesSent, DWORD dwFlags,
+            OVERLAPPED *lpOverlapped) noexcept
+{
+    return ::WSASend(s, std::bit_cast<::WSABUF *>(lpBuffers), dwBufferCount,
+                     lpNumberOfBytesSent, dwFlags,
+                     std::bit_cast<::OVERLAPPED *>(lpOverlapped), nullptr);
+}
+
+BOOL AcceptEx(SOCKET sListenSocket, SOCKET sAcceptSocket, PVOID lpOutputBuffer,
+              DWORD dwReceiveDataLength, DWORD dwLocalAddressLength,
+              DWORD dwRemoteAddressLength, LPDWORD lpdwBytesReceived,
+              OVERLAPPED *lpOverlapped) noexcept
+{
+    static_assert(accept_addr_size == sizeof(SOCKADDR_IN6) + 16);
+    return ::AcceptEx(sListenSocket, sAcceptSocket, lpOutputBuffer,
+                      dwReceiveDataLength, dwLocalAddressLength,
+                      dwRemoteAddressLength, lpdwBytesReceived,
+                      std::bit_cast<::OVERLAPPED *>(lpOverlapped));
+}
+
+BOOL ConnectEx(SOCKET s, const void *name, int namelen,
+               PVOID lpSendBuffer, DWORD dwSendDataLength,
+               LPDWORD lpdwBytesSent, OVERLAPPED *lpOverlapped) noexcept
+{
+    // An extension only reachable through a socket; the sockets koru creates
+    // all share the same provider
+    static const auto fn = [s] {
+        LPFN_CONNECTEX f = nullptr;
+        GUID guid        = WSAID_CONNECTEX;
+        DWORD n;
+        WSAIoctl(s, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid), &f,
+                 sizeof(f), &n, nullptr, nullptr);
+        return f;
+    }();
+    if (!fn) [[unlikely]] {
+        WSASetLastError(WSAEOPNOTSUPP);
+        return false;
+    }
+    return fn(s, static_cast<const ::sockaddr *>(name), namelen,
+              lpSendBuffer, dwSendDataLength, lpdwBytesSent,
+              std::bit_cast<::OVERLAPPED *>(lpOverlapped));
+}
+
 void InitializeSRWLock(SRWLOCK *SRWLock) noexcept
 {
     ::InitializeSRWLock(std::bit_cast<::SRWLOCK *>(SRWLock));
@@ -0,0 +1,78 @@
+//
+// Test cases for the absence of heap allocations on steady-state paths
+//
+
+#include <cstdlib>
+#include <filesystem>
+#include <koru/all.h>
+#include <new>
+#include <vector>
+
+#pragma warning(push, 3)
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#pragma warning(pop)
+
+// TODO: figure out why these warnings happen
+#pragma warning(disable : 4626 5027)
+
+// Counts the allocations of the thread running the test, leaving out the
+// ones of the system's threads
+static thread_local std::size_t allocations = 0;
+
+void *operator new(const std::size_t n)
+{
+    ++allocations;
+    if (const auto p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc{};
+}
+void operator delete(void *const p) noexcept { std::free(p); }
+void operator delete(void *const p, std::size_t) noexcept { std::free(p); }
+
+constexpr uint32_t chunk = 4096;
+
+koru::sync_task<std::size_t> read_chunk(auto &ctx, const auto &f,
+                                        const uint64_t offset, char *buf)
+{
+    co_return co_await ctx.read(f.at(offset), buf, chunk);
+}
+
+koru::sync_task<void> steady_state(auto &ctx, const auto &f, char *buf)
+{
+    for (uint64_t i = 0; i < 64; ++i) {
+        const auto offset = i % 4 * chunk;
+        co_await ctx.write(f.at(offset), buf, chunk);
+        co_await ctx.read(f.at(offset), buf, chunk);
+        if (!co_await ctx.try_read(f.at(offset), buf, chunk))
+            co_return;
+        co_await read_chunk(ctx, f, offset, buf);
+        co_await ctx.schedule();
+    }
+}
+
+std::size_t allocations_of(auto &ctx, const auto &f, char *buf)
+{
+    const auto before = allocations;
+    {
+        auto t = steady_state(ctx, f, buf);
+        ctx.run();
+        t.get();
+    }
+    return allocations - before;
+}
+
+TEST_CASE("steady-state I/Os and resumptions take no heap allocation")
+{
+    const auto test = [](auto ctx) {
+        const auto f = ctx.file(L"alloc.bin", koru::access::read_write);
+        std::vector<char> buf(chunk);
+        // The first run creates the events and fills the frame pool
+        allocations_of(ctx, f, buf.data());
+        REQUIRE_EQ(allocations_of(ctx, f, buf.data()), 0);
+    };
+    test(koru::context<false, false>{});
+    test(koru::context<true, false>{});
+    test(koru::context<true, true>{});
+    std::filesystem::remove("alloc.bin");
+}
\ No newline at end of file
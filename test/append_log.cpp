@@ -0,0 +1,103 @@
+//
+// Test cases for timers and the group-committing append log
+//
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <koru/all.h>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#pragma warning(push, 3)
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#pragma warning(pop)
+
+// TODO: figure out why these warnings happen
+#pragma warning(disable : 4626 5027)
+
+constexpr int nrecords = 200;
+constexpr int rec_size = 8;
+
+koru::sync_task<void> sleep_twice(auto &ctx)
+{
+    co_await ctx.sleep_for(std::chrono::milliseconds{0});
+    co_await ctx.sleep_for(std::chrono::milliseconds{20});
+}
+
+koru::sync_task<uint64_t> append_record(auto &log, const int i)
+{
+    char rec[rec_size + 1];
+    snprintf(rec, sizeof(rec), "rec%04d\n", i);
+    co_return co_await log.append(std::as_bytes(std::span{rec, rec_size}));
+}
+
+koru::sync_task<std::string> read_all(auto &ctx, const koru::detail::file &f)
+{
+    std::string s(nrecords * rec_size, '\0');
+    s.resize(co_await ctx.read(f.at(0), s.data(),
+                               static_cast<uint32_t>(s.size())));
+    co_return s;
+}
+
+TEST_CASE("sleeping suspends for at least the given duration")
+{
+    koru::context ctx;
+    const auto t0 = std::chrono::steady_clock::now();
+    auto t        = sleep_twice(ctx);
+    REQUIRE(ctx.run() == 1);
+    REQUIRE(std::chrono::steady_clock::now() - t0 >=
+            std::chrono::milliseconds{20});
+    t.get();
+}
+
+TEST_CASE("appends get committed in groups")
+{
+    std::remove("append_log.txt");
+    {
+        koru::context ctx;
+        const auto f = ctx.file(L"append_log.txt", koru::access::read_write);
+
+        koru::append_log_options opts;
+        SUBCASE("without delay") {}
+        SUBCASE("with delay and small batches")
+        {
+            opts.max_batch_bytes = 64;
+            opts.max_delay       = std::chrono::milliseconds{1};
+        }
+        SUBCASE("with flushes run inline")
+        {
+            // Extending writes complete synchronously, so the awaiting
+            // coroutines get resumed before their appends return.
+            ctx.set_offload_limits({.threads = 0});
+        }
+        koru::append_log log{ctx, f, 0, opts};
+
+        std::vector<std::unique_ptr<koru::sync_task<uint64_t>>> tasks;
+        for (int i = 0; i < nrecords; ++i)
+            tasks.emplace_back(
+                new koru::sync_task<uint64_t>(append_record(log, i)));
+        ctx.run();
+        REQUIRE(!log.busy());
+        REQUIRE(log.end() == uint64_t{nrecords * rec_size});
+
+        // Records are durable once their appends complete; fewer flushes than
+        // records were needed to get there.
+        REQUIRE(ctx.offload_stats().completed < nrecords);
+
+        auto contents = read_all(ctx, f);
+        ctx.run();
+        const auto &s = contents.get();
+        REQUIRE(s.size() == nrecords * rec_size);
+        for (int i = 0; i < nrecords; ++i) {
+            const auto off = tasks[static_cast<std::size_t>(i)]->get();
+            char rec[rec_size + 1];
+            snprintf(rec, sizeof(rec), "rec%04d\n", i);
+            REQUIRE(std::string_view{s}.substr(off, rec_size) ==
+                    std::string_view(rec, rec_size));
+        }
+    }
+    std::filesystem::remove("append_log.txt");
+}
\ No newline at end of file
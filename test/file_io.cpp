@@ -4,6 +4,7 @@
 
 #include <charconv>
 #include <filesystem>
+#include <fstream>
 #include <koru/all.h>
 #include <semaphore>
 
@@ -20,8 +21,9 @@ koru::sync_task<std::size_t> write_hash(auto &ctx, const wchar_t *src,
 {
     std::size_t h;
     {
-        auto f          = ctx.file(src);
-        auto sz         = GetFileSize(f.native_handle, nullptr);
+        auto f          = co_await ctx.open(src);
+        auto st         = co_await ctx.stat(f);
+        auto sz         = static_cast<DWORD>(st.size);
         auto buf        = std::make_unique_for_overwrite<char[]>(sz);
         auto bytes_read = co_await ctx.read(f.at(0), buf.get(), sz);
         h = std::hash<std::string_view>{}({buf.get(), bytes_read});
@@ -29,7 +31,7 @@ koru::sync_task<std::size_t> write_hash(auto &ctx, const wchar_t *src,
     {
         char buf[32];
         auto sz = snprintf(buf, 32, "%zu", h);
-        auto f  = ctx.file(dst, koru::access::write);
+        auto f  = co_await ctx.open(dst, koru::access::write);
         co_await ctx.write(f.at(0), &buf[0], static_cast<DWORD>(sz));
     }
     co_return h;
@@ -37,8 +39,9 @@ koru::sync_task<std::size_t> write_hash(auto &ctx, const wchar_t *src,
 
 koru::sync_task<std::size_t> read_hash(auto &ctx, const wchar_t *path)
 {
-    auto f          = ctx.file(path);
-    auto sz         = GetFileSize(f.native_handle, nullptr);
+    auto f          = co_await ctx.open(path);
+    auto st         = co_await ctx.stat(f);
+    auto sz         = static_cast<DWORD>(st.size);
     auto buf        = std::make_unique_for_overwrite<char[]>(sz);
     auto bytes_read = co_await ctx.read(f.at(0), buf.get(), sz);
     std::size_t res{};
@@ -48,6 +51,74 @@ koru::sync_task<std::size_t> read_hash(auto &ctx, const wchar_t *path)
     co_return res;
 }
 
+koru::sync_task<koru::file_stat> file_lifecycle(auto &ctx, const wchar_t *path)
+{
+    static constexpr char data[] = "koru";
+    {
+        auto f = co_await ctx.open(path, koru::access::write);
+        co_await ctx.allocate(f, 0, 4096);
+        co_await ctx.write(f.at(0), &data[0], sizeof(data));
+        co_await ctx.fdatasync(f);
+        co_await ctx.fsync(f);
+        co_await ctx.close(f);
+    }
+    auto f = co_await ctx.open(path);
+    char buf[sizeof(data)];
+    if (co_await ctx.read(f.at(0), &buf[0], sizeof(buf)) != sizeof(data) ||
+        std::string_view{buf, sizeof(buf)} !=
+            std::string_view{data, sizeof(data)})
+        throw std::runtime_error{"unexpected file contents"};
+    co_return co_await ctx.stat(f);
+}
+
+struct try_io_results {
+    koru::expected<std::size_t, std::error_code> read, read_past_end, write;
+};
+
+koru::nothrow_task<try_io_results> try_io(auto &ctx, const wchar_t *path)
+{
+    // Writing through a handle opened for reading fails
+    auto f = ctx.file(path);
+    char buf[16];
+    const auto read = co_await ctx.try_read(f.at(0), &buf[0], sizeof(buf));
+    const auto read_past_end =
+        co_await ctx.try_read(f.at(4096), &buf[0], sizeof(buf));
+    const auto write = co_await ctx.try_write(f.at(0), &buf[0], sizeof(buf));
+    co_return try_io_results{read, read_past_end, write};
+}
+
+koru::sync_task<std::string>
+read_chunk(auto &sched, const koru::detail::file &f, const uint64_t offset)
+{
+    std::string s(16, '\0');
+    s.resize(co_await sched.read(f.at(offset), s.data(), 16));
+    co_return s;
+}
+
+koru::sync_task<std::string> read_twice(auto &cache,
+                                        const koru::detail::file &f,
+                                        const uint64_t offset)
+{
+    std::string s(100, '\0');
+    s.resize(co_await cache.read(f.at(offset), s.data(), 100));
+    std::string again(100, '\0');
+    again.resize(co_await cache.read(f.at(offset), again.data(), 100));
+    if (s != again)
+        throw std::runtime_error{"cached bytes differ"};
+    co_return s;
+}
+
+koru::sync_task<std::vector<std::wstring>>
+scan_all(auto &ctx, std::wstring root, const koru::scan_options opts)
+{
+    constexpr wchar_t sep = std::filesystem::path::preferred_separator;
+    std::vector<std::wstring> paths;
+    auto scan = koru::scan_dir(ctx, std::move(root), opts);
+    while (const auto e = co_await scan.next())
+        paths.push_back(e->is_directory() ? e->path + sep : e->path);
+    co_return paths;
+}
+
 auto init_test_case(auto &ctx)
 {
     auto f1 = write_hash(ctx, LR"(..\..\..\CMakeLists.txt)", L"h1.txt");
@@ -110,4 +181,444 @@ TEST_CASE("expected file hashes get expectedly written")
             std::filesystem::remove("h2.txt");
         });
     }
+}
+
+koru::sync_task<void> yield_n(auto &ctx, const int n)
+{
+    for (int i = 0; i < n; ++i)
+        co_await ctx.schedule();
+}
+
+koru::sync_task<void> pause_for(auto &ctx, const std::chrono::milliseconds d)
+{
+    co_await ctx.sleep_for(d);
+}
+
+TEST_CASE("run variants respond to completions")
+{
+    SUBCASE("poll() eventually drains all work")
+    {
+        for_each_ctx([](auto ctx) {
+            auto f1 = write_hash(ctx, LR"(..\..\..\CMakeLists.txt)", L"h1.txt");
+            std::size_t n = 0;
+            while (!f1.await_ready())
+                n += ctx.poll();
+            // Opening both files and the stat get offloaded, and the read
+            // and the write may complete synchronously
+            REQUIRE_GE(n, 3);
+            REQUIRE_LE(n, 5);
+            REQUIRE_EQ(ctx.poll(), 0);
+            std::filesystem::remove("h1.txt");
+
+            auto y = yield_n(ctx, 3);
+            n      = 0;
+            while (!y.await_ready())
+                n += ctx.poll();
+            REQUIRE_EQ(n, 3);
+        });
+    }
+
+    SUBCASE("run_once() resumes at most one coroutine")
+    {
+        for_each_ctx([](auto ctx) {
+            auto f1 = write_hash(ctx, LR"(..\..\..\CMakeLists.txt)", L"h1.txt");
+            auto f2 = write_hash(ctx, LR"(..\..\..\.clang-format)", L"h2.txt");
+            while (!f1.await_ready() || !f2.await_ready())
+                REQUIRE_EQ(ctx.run_once(), 1);
+            REQUIRE_EQ(ctx.run_once(), 0);
+            std::filesystem::remove("h1.txt");
+            std::filesystem::remove("h2.txt");
+        });
+    }
+
+    SUBCASE("run_for() returns once there's no more work")
+    {
+        for_each_ctx([](auto ctx) {
+            auto f1 = write_hash(ctx, LR"(..\..\..\CMakeLists.txt)", L"h1.txt");
+            ctx.run_for(std::chrono::seconds{5});
+            REQUIRE(f1.await_ready());
+            std::filesystem::remove("h1.txt");
+        });
+    }
+
+    SUBCASE("run_for() returns once the time has elapsed")
+    {
+        for_each_ctx([](auto ctx) {
+            using namespace std::chrono_literals;
+            auto t           = pause_for(ctx, 300ms);
+            const auto start = std::chrono::steady_clock::now();
+            ctx.run_for(20ms);
+            REQUIRE_LT(std::chrono::steady_clock::now() - start, 300ms);
+            REQUIRE(!t.await_ready());
+            ctx.run();
+            REQUIRE(t.await_ready());
+        });
+    }
+
+    SUBCASE("run_until() returns once there's no more work or time")
+    {
+        for_each_ctx([](auto ctx) {
+            using namespace std::chrono_literals;
+            auto f1 = write_hash(ctx, LR"(..\..\..\CMakeLists.txt)", L"h1.txt");
+            ctx.run_until(std::chrono::steady_clock::now() + 5s);
+            REQUIRE(f1.await_ready());
+            std::filesystem::remove("h1.txt");
+
+            auto t = pause_for(ctx, 300ms);
+            ctx.run_until(std::chrono::steady_clock::now() + 20ms);
+            REQUIRE(!t.await_ready());
+            ctx.run_until(std::chrono::steady_clock::now() + 5s);
+            REQUIRE(t.await_ready());
+        });
+    }
+}
+
+TEST_CASE("non-blocking wait modes respond to completions")
+{
+    for_each_ctx([](auto ctx) {
+        for (auto mode :
+             {koru::wait_mode::spin_then_block, koru::wait_mode::busy_poll}) {
+            ctx.set_wait_policy({.spin_count = 100, .mode = mode});
+            const auto before = ctx.spin_stats();
+            auto f1 = write_hash(ctx, LR"(..\..\..\CMakeLists.txt)", L"h1.txt");
+            const auto n     = ctx.run();
+            const auto after = ctx.spin_stats();
+            REQUIRE(f1.await_ready());
+            REQUIRE_GE(after.hits + after.misses - before.hits - before.misses,
+                       n);
+            std::filesystem::remove("h1.txt");
+        }
+    });
+}
+
+
+TEST_CASE("files can be operated on asynchronously")
+{
+    for_each_ctx([](auto ctx) {
+        auto t = file_lifecycle(ctx, L"lifecycle.txt");
+        ctx.run();
+        REQUIRE_EQ(t.get().size, 4096);
+        REQUIRE_EQ(t.get().links, 1);
+        std::filesystem::remove("lifecycle.txt");
+    });
+    for_each_ctx([](auto ctx) {
+        auto t = file_lifecycle(ctx, L"nonexistent-dir\\lifecycle.txt");
+        ctx.run();
+        REQUIRE_THROWS_AS(t.get(), std::system_error);
+    });
+}
+
+TEST_CASE("try_ variants report failures as values")
+{
+    std::ofstream{"try_io.txt"} << "koru";
+    for_each_ctx([](auto ctx) {
+        auto t = try_io(ctx, L"try_io.txt");
+        ctx.run();
+        const auto &res = t.get();
+        REQUIRE(res.read);
+        REQUIRE_EQ(*res.read, 4);
+        REQUIRE(res.read_past_end);
+        REQUIRE_EQ(*res.read_past_end, 0);
+        REQUIRE(!res.write);
+        REQUIRE(res.write.error());
+    });
+    std::filesystem::remove("try_io.txt");
+}
+
+TEST_CASE("neighbouring reads get merged")
+{
+    std::ifstream in{"../../../CMakeLists.txt", std::ios::binary};
+    const std::string whole{std::istreambuf_iterator<char>{in}, {}};
+
+    for_each_ctx([&](auto ctx) {
+        const auto f = ctx.file(LR"(..\..\..\CMakeLists.txt)");
+
+        // Read every other chunk back to front, leaving gaps of 16 bytes
+        koru::io_scheduler sched{ctx, {.max_gap = 16}};
+        std::vector<uint64_t> offsets;
+        std::vector<std::unique_ptr<koru::sync_task<std::string>>> chunks;
+        for (auto off = (whole.size() - 1) / 32 * 32;; off -= 32) {
+            offsets.push_back(off);
+            chunks.emplace_back(
+                new koru::sync_task<std::string>(read_chunk(sched, f, off)));
+            if (!off)
+                break;
+        }
+        ctx.run();
+        REQUIRE(!sched.busy());
+        REQUIRE_EQ(sched.stats().requests, chunks.size());
+        REQUIRE_EQ(sched.stats().reads, 1);
+        for (std::size_t i = 0; i < chunks.size(); ++i)
+            REQUIRE_EQ(chunks[i]->get(), whole.substr(offsets[i], 16));
+    });
+}
+
+TEST_CASE("reads get served from the block cache")
+{
+    std::ifstream in{"../../../CMakeLists.txt", std::ios::binary};
+    const std::string whole{std::istreambuf_iterator<char>{in}, {}};
+
+    for_each_ctx([&](auto ctx) {
+        const auto f = ctx.file(LR"(..\..\..\CMakeLists.txt)");
+        koru::block_cache cache{ctx, {.capacity = 4 * 64, .block_size = 64}};
+
+        // Each block is read once, the second reader sharing the reads if
+        // they're still in flight
+        auto t1 = read_twice(cache, f, 10);
+        auto t2 = read_twice(cache, f, 10);
+        ctx.run();
+        REQUIRE_EQ(t1.get(), whole.substr(10, 100));
+        REQUIRE_EQ(t2.get(), whole.substr(10, 100));
+        auto stats = cache.stats();
+        REQUIRE_EQ(stats.misses, 2);
+        REQUIRE_EQ(stats.shared + stats.hits, 6);
+
+        // Reading the whole file evicts blocks, down to the last one
+        auto t3 = read_twice(cache, f, whole.size() - 90);
+        ctx.run();
+        REQUIRE_EQ(t3.get(), whole.substr(whole.size() - 90));
+        stats = cache.stats();
+        REQUIRE_GE(stats.evictions, 1);
+
+        cache.invalidate(f);
+        auto t4 = read_twice(cache, f, 10);
+        ctx.run();
+        REQUIRE_EQ(t4.get(), whole.substr(10, 100));
+        REQUIRE_EQ(cache.stats().misses, stats.misses + 2);
+    });
+}
+
+TEST_CASE("files get copied with many chunks in flight")
+{
+    std::ifstream in{"../../../CMakeLists.txt", std::ios::binary};
+    const std::string whole{std::istreambuf_iterator<char>{in}, {}};
+
+    for_each_ctx([&](auto ctx) {
+        {
+            const auto src = ctx.file(LR"(..\..\..\CMakeLists.txt)");
+            const auto dst = ctx.file(L"copy.txt", koru::access::read_write);
+            uint64_t last = 0, total = 0;
+            auto t = koru::copy(ctx, src, dst,
+                                {.chunk_size = 64,
+                                 .depth      = 4,
+                                 .progress   = [&](uint64_t done, uint64_t n) {
+                                     REQUIRE_GT(done, last);
+                                     last  = done;
+                                     total = n;
+                                 }});
+            ctx.run();
+            REQUIRE_EQ(t.get(), whole.size());
+            REQUIRE_EQ(last, total);
+        }
+        std::ifstream out{"copy.txt", std::ios::binary};
+        const std::string copied{std::istreambuf_iterator<char>{out}, {}};
+        REQUIRE_EQ(copied, whole);
+        out.close();
+        std::filesystem::remove("copy.txt");
+    });
+}
+
+koru::sync_task<void> write_sparse(auto &ctx, const wchar_t *path,
+                                   const std::string &data)
+{
+    // Only the first and last 64 KiB get written, leaving a hole between
+    const auto f = ctx.file(path, koru::access::read_write);
+    koru::detail::set_sparse(f.native_handle);
+    koru::detail::set_size(f.native_handle, data.size());
+    constexpr uint32_t unit = 64 * 1024;
+    co_await ctx.write(f.at(0), data.data(), unit);
+    const auto tail = data.size() - unit;
+    co_await ctx.write(f.at(tail), data.data() + tail, unit);
+}
+
+TEST_CASE("sparse files get copied with their holes")
+{
+    constexpr uint32_t unit = 64 * 1024;
+    std::string data(4 * unit, '\0');
+    for (std::size_t i = 0; i < data.size(); ++i)
+        if (i < unit || i >= 3 * unit)
+            data[i] = static_cast<char>('a' + i % 26);
+
+    for_each_ctx([&](auto ctx) {
+        auto w = write_sparse(ctx, L"sparse.bin", data);
+        ctx.run();
+        w.get();
+        {
+            const auto src = ctx.file(L"sparse.bin");
+            const auto dst =
+                ctx.file(L"sparse_copy.bin", koru::access::read_write);
+            const auto src_ranges = koru::detail::all_allocated_ranges(
+                src.native_handle, data.size());
+            uint64_t allocated = 0;
+            for (const auto &r : src_ranges)
+                allocated += r.length;
+            REQUIRE_LT(allocated, data.size());
+
+            uint64_t last = 0, total = 0;
+            auto t = koru::copy(ctx, src, dst,
+                                {.chunk_size = unit / 4,
+                                 .depth      = 4,
+                                 .clone      = false,
+                                 .progress   = [&](uint64_t done, uint64_t n) {
+                                     REQUIRE_GT(done, last);
+                                     last  = done;
+                                     total = n;
+                                 }});
+            ctx.run();
+            REQUIRE_EQ(t.get(), data.size());
+            REQUIRE_EQ(total, allocated);
+            REQUIRE_EQ(last, total);
+
+            const auto dst_ranges = koru::detail::all_allocated_ranges(
+                dst.native_handle, data.size());
+            REQUIRE_EQ(dst_ranges.size(), src_ranges.size());
+            for (std::size_t i = 0; i < dst_ranges.size(); ++i) {
+                REQUIRE_EQ(dst_ranges[i].offset, src_ranges[i].offset);
+                REQUIRE_EQ(dst_ranges[i].length, src_ranges[i].length);
+            }
+        }
+        std::ifstream out{"sparse_copy.bin", std::ios::binary};
+        const std::string copied{std::istreambuf_iterator<char>{out}, {}};
+        REQUIRE(copied == data);
+        out.close();
+        std::filesystem::remove("sparse.bin");
+        std::filesystem::remove("sparse_copy.bin");
+    });
+}
+
+koru::sync_task<std::size_t> copy_block(auto &ctx, const wchar_t *src,
+                                        const wchar_t *dst)
+{
+    const auto in  = ctx.file(src);
+    const auto out = ctx.file(dst, koru::access::write);
+    char buf[64];
+    const auto [read, written, synced] = co_await ctx.chain(
+        [&] { return ctx.read(in.at(0), &buf[0], sizeof(buf)); },
+        [&](const std::size_t n) {
+            return ctx.write(out.at(0), &buf[0], static_cast<uint32_t>(n));
+        },
+        [&] { return ctx.fsync(out); });
+    REQUIRE_EQ(read, written);
+    co_return written;
+}
+
+TEST_CASE("chained operations run as a unit")
+{
+    std::ifstream in{"../../../CMakeLists.txt", std::ios::binary};
+    const std::string whole{std::istreambuf_iterator<char>{in}, {}};
+
+    for_each_ctx([&](auto ctx) {
+        auto t = copy_block(ctx, LR"(..\..\..\CMakeLists.txt)", L"block.txt");
+        ctx.run();
+        REQUIRE_EQ(t.get(), 64);
+
+        // Writing through a handle opened for reading fails, ending the chain
+        const auto f = ctx.file(L"block.txt");
+        bool synced  = false;
+        auto failed  = ctx.chain(
+            [&] { return ctx.write(f.at(0), whole.data(), 4); },
+            [&] {
+                synced = true;
+                return ctx.fsync(f);
+            });
+        ctx.run();
+        REQUIRE_THROWS_AS(failed.get(), std::system_error);
+        REQUIRE(!synced);
+    });
+    std::ifstream block{"block.txt", std::ios::binary};
+    const std::string copied{std::istreambuf_iterator<char>{block}, {}};
+    REQUIRE_EQ(copied, whole.substr(0, 64));
+    block.close();
+    std::filesystem::remove("block.txt");
+}
+
+koru::sync_task<std::vector<std::string>>
+read_frames(auto &ctx, const wchar_t *path, auto codec)
+{
+    const auto f = ctx.file(path);
+    koru::framed_reader r{ctx, f, codec,
+                          {.buffer_size = 16, .max_frame_size = 256}};
+    std::vector<std::string> frames;
+    while (const auto frame = co_await r.next())
+        frames.emplace_back(reinterpret_cast<const char *>(frame->data()),
+                            frame->size());
+    co_return frames;
+}
+
+TEST_CASE("framed readers split streams into frames")
+{
+    // Frames of up to 199 bytes outgrow the buffer and need 2-byte varints
+    std::vector<std::string> frames;
+    for (int i = 0; i < 50; ++i)
+        frames.emplace_back(static_cast<std::size_t>(i * 37 % 200),
+                            static_cast<char>('a' + i % 26));
+    {
+        std::ofstream lines{"lines.txt", std::ios::binary},
+            varint{"varint.bin", std::ios::binary},
+            fixed{"fixed.bin", std::ios::binary},
+            truncated{"truncated.bin", std::ios::binary};
+        for (const auto &frame : frames) {
+            lines << frame << '\n';
+            for (auto n = frame.size();;) {
+                const auto b = static_cast<char>(n & 0x7f);
+                n >>= 7;
+                varint << static_cast<char>(b | (n ? 0x80 : 0));
+                if (!n)
+                    break;
+            }
+            varint << frame;
+            fixed << static_cast<char>(frame.size() >> 8)
+                  << static_cast<char>(frame.size() & 0xff) << frame;
+        }
+        truncated << '\0' << '\x0a' << "koru";
+    }
+
+    for_each_ctx([&](auto ctx) {
+        auto t1 = read_frames(ctx, L"lines.txt", koru::delimiter_codec{});
+        auto t2 = read_frames(ctx, L"varint.bin", koru::varint_codec{});
+        auto t3 = read_frames(ctx, L"fixed.bin", koru::fixed_codec<2>{});
+        auto t4 = read_frames(ctx, L"truncated.bin", koru::fixed_codec<2>{});
+        ctx.run();
+        REQUIRE(t1.get() == frames);
+        REQUIRE(t2.get() == frames);
+        REQUIRE(t3.get() == frames);
+        REQUIRE_THROWS_AS(t4.get(), std::system_error);
+    });
+    for (const auto path : {"lines.txt", "varint.bin", "fixed.bin",
+                            "truncated.bin"})
+        std::filesystem::remove(path);
+}
+
+TEST_CASE("directory trees get scanned")
+{
+    constexpr wchar_t sep = std::filesystem::path::preferred_separator;
+    const std::filesystem::path root{"scan"};
+    std::filesystem::remove_all(root);
+    std::vector<std::wstring> expected;
+    for (int i = 0; i < 4; ++i) {
+        const auto dir = root / ("d" + std::to_string(i));
+        std::filesystem::create_directories(dir / "sub");
+        expected.push_back(dir.wstring() + sep);
+        expected.push_back((dir / "sub").wstring() + sep);
+        for (int j = 0; j < 10; ++j) {
+            const auto f = dir / "sub" / ("f" + std::to_string(j));
+            std::ofstream{f} << j;
+            expected.push_back(f.wstring());
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    for_each_ctx([&](auto ctx) {
+        auto t = scan_all(ctx, root.wstring(),
+                          {.max_open = 3, .max_buffered = 8});
+        ctx.run();
+        auto paths = t.get();
+        std::sort(paths.begin(), paths.end());
+        REQUIRE(paths == expected);
+
+        auto missing = scan_all(ctx, (root / "missing").wstring(), {});
+        ctx.run();
+        REQUIRE_THROWS_AS(missing.get(), std::system_error);
+    });
+    std::filesystem::remove_all(root);
 }
\ No newline at end of file
@@ -0,0 +1,431 @@
+//
+// Test cases for socket I/O
+//
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <koru/all.h>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#pragma warning(push, 3)
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#pragma warning(pop)
+
+// TODO: figure out why these warnings happen
+#pragma warning(disable : 4626 5027)
+
+constexpr int ndatagrams = 64;
+
+koru::sync_task<void> send_all(auto &ctx, auto &tx)
+{
+    std::vector<int> values(ndatagrams);
+    std::iota(values.begin(), values.end(), 0);
+    std::vector<koru::msg_buf> msgs;
+    for (auto &x : values)
+        msgs.push_back({.data = &x, .size = sizeof(x)});
+    for (std::size_t sent = 0; sent < msgs.size();)
+        sent += co_await ctx.send_many(tx, std::span{msgs}.subspan(sent));
+}
+
+koru::sync_task<int> receive_all(auto &ctx, auto &rx, std::vector<int> &values)
+{
+    values.resize(ndatagrams);
+    std::vector<koru::msg_buf> msgs;
+    for (auto &x : values)
+        msgs.push_back({.data = &x, .size = sizeof(x)});
+    int batches = 0;
+    for (std::size_t received = 0; received < msgs.size(); ++batches) {
+        const auto n =
+            co_await ctx.recv_many(rx, std::span{msgs}.subspan(received));
+        REQUIRE_GE(n, 1);
+        for (std::size_t i = received; i < received + n; ++i)
+            REQUIRE_EQ(msgs[i].nbytes, sizeof(int));
+        received += n;
+    }
+    co_return batches;
+}
+
+TEST_CASE("datagrams get transferred in batches")
+{
+    koru::context ctx;
+    auto rx = ctx.bind(L"127.0.0.1", L"27015", koru::udp4);
+    auto tx = ctx.connect(L"127.0.0.1", L"27015", koru::udp4);
+    std::vector<int> values;
+
+    SUBCASE("receiving suspends until the first datagram arrives")
+    {
+        auto r = receive_all(ctx, rx, values);
+        auto s = send_all(ctx, tx);
+        ctx.run();
+        s.get();
+        REQUIRE_LT(r.get(), ndatagrams);
+    }
+    SUBCASE("queued datagrams get received at once")
+    {
+        auto s = send_all(ctx, tx);
+        ctx.run();
+        s.get();
+        auto r = receive_all(ctx, rx, values);
+        ctx.run();
+        REQUIRE_EQ(r.get(), 1);
+    }
+    for (int i = 0; i < ndatagrams; ++i)
+        REQUIRE_EQ(values[static_cast<std::size_t>(i)], i);
+}
+
+koru::sync_task<std::size_t> send_texts(auto &ctx, auto &tx,
+                                        std::vector<std::string> texts)
+{
+    std::vector<koru::msg_buf> msgs;
+    for (auto &t : texts)
+        msgs.push_back(
+            {.data = t.data(), .size = static_cast<uint32_t>(t.size())});
+    co_return co_await ctx.send_many(tx, msgs);
+}
+
+koru::sync_task<std::size_t> receive_some(auto &ctx, auto &rx,
+                                          const std::span<koru::msg_buf> msgs)
+{
+    co_return co_await ctx.recv_many(rx, msgs);
+}
+
+TEST_CASE("oversized datagrams get received truncated")
+{
+    koru::context ctx;
+    auto rx = ctx.bind(L"127.0.0.1", L"27021", koru::udp4);
+    auto tx = ctx.connect(L"127.0.0.1", L"27021", koru::udp4);
+    std::array<std::array<char, 4>, 2> bufs;
+    std::array<koru::msg_buf, 2> msgs{{{.data = bufs[0].data(), .size = 4},
+                                       {.data = bufs[1].data(), .size = 4}}};
+
+    SUBCASE("the datagram awaited gets flagged")
+    {
+        auto r = receive_some(ctx, rx, msgs);
+        auto s = send_texts(ctx, tx, {"abcdefgh"});
+        ctx.run();
+        REQUIRE_EQ(s.get(), 1);
+        REQUIRE_EQ(r.get(), 1);
+    }
+    SUBCASE("queued datagrams get flagged one by one")
+    {
+        auto s = send_texts(ctx, tx, {"abcdefgh", "ijkl"});
+        ctx.run();
+        REQUIRE_EQ(s.get(), 2);
+        auto r = receive_some(ctx, rx, msgs);
+        ctx.run();
+        REQUIRE_EQ(r.get(), 2);
+        REQUIRE(!msgs[1].truncated);
+        REQUIRE_EQ(msgs[1].nbytes, 4);
+        REQUIRE_EQ(std::string_view(bufs[1].data(), 4), "ijkl");
+    }
+    REQUIRE(msgs[0].truncated);
+    REQUIRE_EQ(msgs[0].nbytes, 4);
+    REQUIRE_EQ(std::string_view(bufs[0].data(), 4), "abcd");
+}
+
+TEST_CASE("segmented sends arrive as several datagrams")
+{
+    koru::context ctx;
+    auto rx = ctx.bind(L"127.0.0.1", L"27022", koru::udp4);
+    auto tx = ctx.connect(L"127.0.0.1", L"27022", koru::udp4);
+    // Segmentation offload needs Windows 10 version 2004 or later
+    if (!tx.set_send_segment_size(4))
+        return;
+
+    auto s = send_texts(ctx, tx, {"abcdefghij"});
+    ctx.run();
+    REQUIRE_EQ(s.get(), 1);
+    std::array<std::array<char, 8>, 3> bufs;
+    std::array<koru::msg_buf, 3> msgs{{{.data = bufs[0].data(), .size = 8},
+                                       {.data = bufs[1].data(), .size = 8},
+                                       {.data = bufs[2].data(), .size = 8}}};
+    std::string received;
+    for (std::size_t n = 0; n < msgs.size();) {
+        auto r = receive_some(ctx, rx, std::span{msgs}.subspan(n));
+        ctx.run();
+        for (const auto end = n + r.get(); n < end; ++n) {
+            REQUIRE_EQ(msgs[n].nbytes, n < 2 ? 4 : 2);
+            received.append(static_cast<const char *>(msgs[n].data),
+                            msgs[n].nbytes);
+        }
+    }
+    REQUIRE_EQ(received, "abcdefghij");
+    REQUIRE(tx.set_send_segment_size(0));
+}
+
+koru::sync_task<void> send_and_close(auto &ctx, const auto &ls,
+                                     const std::string msg)
+{
+    const auto s = co_await ctx.accept(ls);
+    co_await ctx.send(s, msg.data(), static_cast<uint32_t>(msg.size()));
+}
+
+koru::sync_task<koru::recv_buffer> recv_buffer_of(auto &ctx, auto &group,
+                                                  const auto &s)
+{
+    co_return co_await group.recv(ctx, s);
+}
+
+std::string text_of(const koru::recv_buffer &b)
+{
+    return {reinterpret_cast<const char *>(b.data()), b.size()};
+}
+
+TEST_CASE("receive buffer groups lend buffers to pending data only")
+{
+    koru::context ctx;
+    const auto ls = ctx.listen(L"127.0.0.1", L"27020", koru::tcp4);
+    const auto c  = ctx.connect(L"127.0.0.1", L"27020", koru::tcp4);
+    koru::recv_buffer_group group{1, 4};
+
+    SUBCASE("data waits for a buffer to be free")
+    {
+        auto s  = send_and_close(ctx, ls, "abcdefgh");
+        auto r1 = recv_buffer_of(ctx, group, c);
+        ctx.run();
+        s.get();
+        auto &b = r1.get();
+        REQUIRE_EQ(text_of(b), "abcd");
+        auto r2 = recv_buffer_of(ctx, group, c);
+        ctx.run();
+        REQUIRE_THROWS_AS(r2.get(), std::system_error);
+        b.reset();
+        auto r3 = recv_buffer_of(ctx, group, c);
+        ctx.run();
+        REQUIRE_EQ(text_of(r3.get()), "efgh");
+    }
+    SUBCASE("the end of the stream takes no buffer")
+    {
+        auto s  = send_and_close(ctx, ls, "abcd");
+        auto r1 = recv_buffer_of(ctx, group, c);
+        ctx.run();
+        s.get();
+        REQUIRE_EQ(text_of(r1.get()), "abcd");
+        REQUIRE_EQ(group.available(), 0);
+        auto r2 = recv_buffer_of(ctx, group, c);
+        ctx.run();
+        REQUIRE(!r2.get());
+    }
+}
+
+koru::sync_task<void> echo(auto &ctx, const auto &s)
+{
+    char buf[64];
+    while (const auto n = co_await ctx.recv(s, &buf[0], sizeof(buf)))
+        co_await ctx.send(s, &buf[0], static_cast<uint32_t>(n));
+}
+
+koru::sync_task<std::string> ping(auto &ctx, auto &group, const int i)
+{
+    const auto s   = ctx.connect(L"127.0.0.1", L"27016", koru::tcp4);
+    const auto msg = "ping " + std::to_string(i);
+    co_await ctx.send(s, msg.data(), static_cast<uint32_t>(msg.size()));
+    const auto b = co_await group.recv(ctx, s);
+    co_return std::string{reinterpret_cast<const char *>(b.data()), b.size()};
+}
+
+TEST_CASE("listeners serve connections on all shards")
+{
+    constexpr std::array<unsigned, 2> cpus{0, 0};
+    koru::runtime rt{cpus};
+    koru::context ctx;
+    const auto ls = ctx.listen(L"127.0.0.1", L"27016", koru::tcp4);
+
+    // Each connection taking the accept posted first, and every shard
+    // reposting its accepts behind the others', both shards get to serve
+    std::array<std::atomic<int>, cpus.size()> served{};
+    koru::listener l{rt, ls,
+                     [&](auto &c, const auto &s) {
+                         for (std::size_t i = 0; i < rt.size(); ++i)
+                             if (&c == &rt.shard(i).ctx())
+                                 ++served[i];
+                         return echo(c, s);
+                     },
+                     {.steer = true}};
+    koru::recv_buffer_group group{4, 64};
+    for (int i = 0; i < 20; ++i) {
+        auto t = ping(ctx, group, i);
+        ctx.run();
+        REQUIRE_EQ(t.get(), "ping " + std::to_string(i));
+    }
+    REQUIRE_EQ(group.available(), 4);
+    REQUIRE_EQ(l.accepted(), 20);
+    REQUIRE_EQ(served[0] + served[1], 20);
+    REQUIRE_GT(served[0], 0);
+    REQUIRE_GT(served[1], 0);
+}
+
+koru::sync_task<void> echo_once(auto &ctx, const auto &s)
+{
+    char buf[64];
+    const auto n = co_await ctx.recv(s, &buf[0], sizeof(buf));
+    co_await ctx.send(s, &buf[0], static_cast<uint32_t>(n));
+}
+
+koru::sync_task<std::string> request(auto &ctx, auto &pool, const int i)
+{
+    const auto l   = co_await pool.acquire();
+    const auto msg = "request " + std::to_string(i);
+    const auto &s  = l.socket();
+    co_await ctx.send(s, msg.data(), static_cast<uint32_t>(msg.size()));
+    char buf[64];
+    const auto n = co_await ctx.recv(s, &buf[0], sizeof(buf));
+    REQUIRE_LE(pool.open(), 2);
+    co_return std::string{&buf[0], n};
+}
+
+koru::sync_task<void> request_all(auto &ctx, auto &pool, const int n,
+                                  const std::chrono::milliseconds pause = {})
+{
+    for (int i = 0; i < n; ++i) {
+        REQUIRE_EQ(co_await request(ctx, pool, i),
+                   "request " + std::to_string(i));
+        if (pause.count())
+            co_await ctx.sleep_for(pause);
+    }
+}
+
+TEST_CASE("connection pools reuse live connections")
+{
+    using namespace std::chrono_literals;
+    constexpr std::array<unsigned, 1> cpus{0};
+    koru::runtime rt{cpus};
+    koru::context ctx;
+    const auto ls = ctx.listen(L"127.0.0.1", L"27017", koru::tcp4);
+    koru::connection_pool pool{ctx, ctx.resolve(L"127.0.0.1", L"27017"),
+                               {.max_connections = 2, .idle_timeout = 50ms}};
+
+    SUBCASE("released connections serve the next request")
+    {
+        koru::listener l{rt, ls,
+                         [](auto &c, const auto &s) { return echo(c, s); }};
+        auto t = request_all(ctx, pool, 10);
+        ctx.run();
+        t.get();
+        REQUIRE_EQ(l.accepted(), 1);
+    }
+    SUBCASE("concurrent requests wait for one of the connections")
+    {
+        koru::listener l{rt, ls,
+                         [](auto &c, const auto &s) { return echo(c, s); }};
+        std::vector<std::unique_ptr<koru::sync_task<std::string>>> tasks;
+        for (int i = 0; i < 6; ++i)
+            tasks.emplace_back(
+                new koru::sync_task<std::string>(request(ctx, pool, i)));
+        ctx.run();
+        for (int i = 0; i < 6; ++i)
+            REQUIRE_EQ(tasks[static_cast<std::size_t>(i)]->get(),
+                       "request " + std::to_string(i));
+        REQUIRE_EQ(l.accepted(), 2);
+    }
+    SUBCASE("connections closed by the peer get replaced")
+    {
+        koru::listener l{
+            rt, ls, [](auto &c, const auto &s) { return echo_once(c, s); }};
+        auto t = request_all(ctx, pool, 3, 20ms);
+        ctx.run();
+        t.get();
+        REQUIRE_EQ(l.accepted(), 3);
+    }
+    // Idle connections get closed once they time out
+    REQUIRE_EQ(pool.idle(), 0);
+    REQUIRE_EQ(pool.open(), 0);
+}
+
+koru::sync_task<void> request_then_close(auto &ctx, auto &pool,
+                                         const bool destroy)
+{
+    const auto reply = co_await request(ctx, *pool, 0);
+    REQUIRE_EQ(reply, "request 0");
+    REQUIRE_EQ(pool->idle(), 1);
+    if (destroy)
+        pool.reset();
+    else
+        pool->clear();
+}
+
+TEST_CASE("connection pools stop reaping once no connection is idle")
+{
+    constexpr std::array<unsigned, 1> cpus{0};
+    koru::runtime rt{cpus};
+    koru::context ctx;
+    const auto ls = ctx.listen(L"127.0.0.1", L"27019", koru::tcp4);
+    koru::listener l{rt, ls,
+                     [](auto &c, const auto &s) { return echo(c, s); }};
+    std::optional<koru::connection_pool<koru::context<>>> pool{
+        std::in_place, ctx, ctx.resolve(L"127.0.0.1", L"27019")};
+
+    // Rather than once the idle connection would have timed out
+    bool destroy = false;
+    SUBCASE("when cleared") {}
+    SUBCASE("when destroyed") { destroy = true; }
+    const auto t0 = std::chrono::steady_clock::now();
+    auto t        = request_then_close(ctx, pool, destroy);
+    ctx.run();
+    t.get();
+    REQUIRE_LT(std::chrono::steady_clock::now() - t0, std::chrono::seconds{5});
+}
+
+koru::sync_task<void> recv_byte(auto &ctx, const auto &s, const char tag,
+                                std::string &order)
+{
+    char c;
+    co_await ctx.recv(s, &c, 1);
+    order += tag;
+}
+
+koru::sync_task<void> serve_bytes(auto &ctx, const auto &ls,
+                                  const koru::io_priority p, const char tag,
+                                  std::string &order)
+{
+    auto s = co_await ctx.accept(ls);
+    ctx.set_io_priority(s, p);
+    REQUIRE_EQ(s.priority(), p);
+    koru::sync_task<void> recvs[] = {
+        recv_byte(ctx, s, tag, order), recv_byte(ctx, s, tag, order),
+        recv_byte(ctx, s, tag, order), recv_byte(ctx, s, tag, order)};
+    for (auto &r : recvs)
+        co_await r;
+}
+
+koru::sync_task<void> send_bytes(auto &ctx, const auto &s, const char *str)
+{
+    co_await ctx.send(s, str, 4);
+}
+
+TEST_CASE("completions get resumed by priority class within budgets")
+{
+    using namespace std::chrono_literals;
+    koru::context ctx;
+    ctx.set_priority_budgets({.interactive = 2, .normal = 1, .bulk = 1});
+    const auto ls = ctx.listen(L"127.0.0.1", L"27018", koru::tcp4);
+    const auto ci = ctx.connect(L"127.0.0.1", L"27018", koru::tcp4);
+    std::string order;
+    auto ti = serve_bytes(ctx, ls, koru::io_priority::interactive, 'i', order);
+    ctx.run_for(50ms);
+    const auto cb = ctx.connect(L"127.0.0.1", L"27018", koru::tcp4);
+    auto tb = serve_bytes(ctx, ls, koru::io_priority::bulk, 'b', order);
+    ctx.run_for(50ms);
+    REQUIRE(order.empty());
+
+    // Let all receives complete before any gets responded to
+    auto si = send_bytes(ctx, ci, "iiii");
+    auto sb = send_bytes(ctx, cb, "bbbb");
+    std::this_thread::sleep_for(50ms);
+    ctx.run();
+    si.get();
+    sb.get();
+    ti.get();
+    tb.get();
+    REQUIRE_EQ(order, "iibiibbb");
+}
\ No newline at end of file
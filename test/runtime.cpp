@@ -0,0 +1,106 @@
+//
+// Test cases for the sharded runtime
+//
+
+#include <array>
+#include <koru/all.h>
+#include <semaphore>
+
+#pragma warning(push, 3)
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#pragma warning(pop)
+
+// TODO: figure out why these warnings happen
+#pragma warning(disable : 4626 5027)
+
+koru::sync_task<void> record_thread(std::thread::id &id,
+                                    std::counting_semaphore<> &s)
+{
+    id = std::this_thread::get_id();
+    s.release();
+    co_return;
+}
+
+koru::sync_task<void> hop(auto &rt, std::thread::id (&ids)[3],
+                          std::counting_semaphore<> &s)
+{
+    ids[0] = std::this_thread::get_id();
+    co_await koru::resume_on(rt.shard(1).ctx());
+    ids[1] = std::this_thread::get_id();
+    co_await rt.shard(0).ctx().schedule();
+    ids[2] = std::this_thread::get_id();
+    s.release();
+}
+
+TEST_CASE("runtime shards run work on threads of their own")
+{
+    constexpr std::array<unsigned, 2> cpus{0, 0};
+    koru::runtime rt{cpus};
+    REQUIRE_EQ(rt.size(), 2);
+
+    SUBCASE("posted callables run on the shard's thread")
+    {
+        std::counting_semaphore<> s{0};
+        std::thread::id ids[2];
+        for (std::size_t i = 0; i < rt.size(); ++i)
+            rt.shard(i).post([&, i] {
+                ids[i] = std::this_thread::get_id();
+                s.release();
+            });
+        s.acquire();
+        s.acquire();
+        REQUIRE_NE(ids[0], ids[1]);
+        REQUIRE_NE(ids[0], std::this_thread::get_id());
+    }
+
+    SUBCASE("spawned tasks run on the shard's thread")
+    {
+        std::counting_semaphore<> s{0};
+        std::thread::id posted, spawned;
+        rt.shard(1).post([&] {
+            posted = std::this_thread::get_id();
+            s.release();
+        });
+        rt.shard(1).spawn([&] { return record_thread(spawned, s); });
+        s.acquire();
+        s.acquire();
+        REQUIRE_EQ(posted, spawned);
+    }
+
+    SUBCASE("shards can pass messages to one another")
+    {
+        std::binary_semaphore s{0};
+        int hops = 0;
+        rt.shard(0).post([&] {
+            ++hops;
+            rt.shard(1).post([&] {
+                ++hops;
+                rt.shard(0).post([&] {
+                    ++hops;
+                    s.release();
+                });
+            });
+        });
+        s.acquire();
+        REQUIRE_EQ(hops, 3);
+    }
+
+    SUBCASE("coroutines can hop between shards")
+    {
+        std::counting_semaphore<> s{0};
+        std::thread::id ids[3], shard_ids[2];
+        for (std::size_t i = 0; i < rt.size(); ++i)
+            rt.shard(i).post([&, i] {
+                shard_ids[i] = std::this_thread::get_id();
+                s.release();
+            });
+        s.acquire();
+        s.acquire();
+        rt.shard(0).spawn([&] { return hop(rt, ids, s); });
+        s.acquire();
+        REQUIRE_EQ(ids[0], shard_ids[0]);
+        REQUIRE_EQ(ids[1], shard_ids[1]);
+        REQUIRE_EQ(ids[2], shard_ids[0]);
+    }
+}
\ No newline at end of file
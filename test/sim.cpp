@@ -0,0 +1,144 @@
+//
+// Test cases for the simulated context
+//
+
+#include <chrono>
+#include <cstddef>
+#include <koru/all.h>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#pragma warning(push, 3)
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#pragma warning(pop)
+
+// TODO: figure out why these warnings happen
+#pragma warning(disable : 4626 5027)
+
+using namespace std::chrono_literals;
+
+static std::vector<std::byte> bytes_of(const std::string &s)
+{
+    std::vector<std::byte> v(s.size());
+    for (std::size_t i = 0; i < s.size(); ++i)
+        v[i] = static_cast<std::byte>(s[i]);
+    return v;
+}
+
+koru::sync_task<void> copy_line(auto &ctx, const koru::sim_file &src,
+                                const koru::sim_file &dst)
+{
+    char buf[64];
+    const auto n = co_await ctx.read(src.at(0), &buf[0], sizeof(buf));
+    co_await ctx.sleep_for(1ms);
+    co_await ctx.write(dst.at(0), &buf[0], static_cast<uint32_t>(n));
+}
+
+koru::sync_task<std::size_t> read_byte(auto &ctx,
+                                       const koru::sim_file::location l)
+{
+    char c;
+    co_return co_await ctx.read(l, &c, 1);
+}
+
+TEST_CASE("simulated I/Os complete in virtual time")
+{
+    koru::sim_context ctx{{.latency = koru::fixed_latency(100us)}};
+    const koru::sim_file src{bytes_of("hello\n")}, dst;
+    const auto t0 = ctx.now();
+
+    SUBCASE("dependent I/Os add up")
+    {
+        auto t = copy_line(ctx, src, dst);
+        REQUIRE_EQ(ctx.run(), 3);
+        t.get();
+        REQUIRE_EQ(dst.bytes(), src.bytes());
+        REQUIRE_EQ(ctx.now() - t0, 1200us);
+    }
+    SUBCASE("concurrent I/Os overlap")
+    {
+        auto t1 = copy_line(ctx, src, dst);
+        auto t2 = copy_line(ctx, src, dst);
+        ctx.run_for(50us);
+        REQUIRE(dst.bytes().empty());
+        REQUIRE_EQ(ctx.now() - t0, 50us);
+        ctx.run();
+        t1.get();
+        t2.get();
+        REQUIRE_EQ(dst.bytes(), src.bytes());
+        REQUIRE_EQ(ctx.now() - t0, 1200us);
+    }
+    SUBCASE("reads past the end read nothing")
+    {
+        auto t = read_byte(ctx, src.at(6));
+        ctx.run();
+        REQUIRE_EQ(t.get(), 0);
+    }
+    REQUIRE_EQ(ctx.stats().submitted, ctx.stats().completed);
+}
+
+koru::sync_task<void> read_tagged(auto &ctx, const koru::sim_file &f,
+                                  const char tag, std::string &order)
+{
+    char c;
+    co_await ctx.read(f.at(0), &c, 1);
+    order += tag;
+}
+
+std::string completion_order(const uint64_t seed)
+{
+    koru::sim_context ctx{
+        {.seed = seed, .latency = koru::lognormal_latency(80us, 1.0)}};
+    const koru::sim_file f{bytes_of("x")};
+    std::string order;
+    std::vector<std::unique_ptr<koru::sync_task<void>>> tasks;
+    for (char tag = 'a'; tag <= 'z'; ++tag)
+        tasks.emplace_back(
+            new koru::sync_task<void>(read_tagged(ctx, f, tag, order)));
+    ctx.run();
+    return order + std::to_string(ctx.now().time_since_epoch().count());
+}
+
+TEST_CASE("simulated runs replay deterministically")
+{
+    REQUIRE_EQ(completion_order(42), completion_order(42));
+    REQUIRE_NE(completion_order(42), completion_order(43));
+
+    koru::sim_context ctx{{.latency = koru::replayed_latency({10us, 30us})}};
+    const koru::sim_file f{bytes_of("x")};
+    std::string order;
+    auto t = read_tagged(ctx, f, 'a', order);
+    ctx.run();
+    const auto t0 = ctx.now().time_since_epoch();
+    REQUIRE((t0 == 10us || t0 == 30us));
+}
+
+koru::sync_task<void> read_many(auto &ctx, const koru::sim_file &f,
+                                const int n, int &failures)
+{
+    char c;
+    for (int i = 0; i < n; ++i)
+        if (!co_await ctx.try_read(f.at(0), &c, 1))
+            ++failures;
+}
+
+TEST_CASE("simulated failures get injected")
+{
+    koru::sim_context ctx{{.error_rate = 0.25}};
+    const koru::sim_file f{bytes_of("x")};
+    int failures = 0;
+    auto t       = read_many(ctx, f, 400, failures);
+    ctx.run();
+    t.get();
+    REQUIRE_GT(failures, 50);
+    REQUIRE_LT(failures, 150);
+    REQUIRE_EQ(ctx.stats().failed, static_cast<std::size_t>(failures));
+
+    koru::sim_context failing{{.error_rate = 1}};
+    auto r = read_byte(failing, f.at(0));
+    failing.run();
+    REQUIRE_THROWS_AS(r.get(), std::system_error);
+}
\ No newline at end of file
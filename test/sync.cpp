@@ -0,0 +1,230 @@
+//
+// Test cases for channels and other coroutine synchronization
+//
+
+#include <algorithm>
+#include <array>
+#include <koru/all.h>
+#include <memory>
+#include <semaphore>
+#include <stdexcept>
+#include <vector>
+
+#pragma warning(push, 3)
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest.h>
+#pragma warning(pop)
+
+// TODO: figure out why these warnings happen
+#pragma warning(disable : 4626 5027)
+
+constexpr int nvalues = 1000;
+
+koru::sync_task<void> produce(auto &ctx, auto &out)
+{
+    for (int i = 0; i < nvalues; ++i)
+        REQUIRE(co_await out.send(ctx, i));
+    out.close();
+}
+
+koru::sync_task<void> twice(auto &ctx, auto &in, auto &out)
+{
+    while (const auto x = co_await in.recv(ctx)) {
+        REQUIRE_LE(in.size(), 4);
+        co_await out.send(ctx, *x * 2);
+    }
+    out.close();
+}
+
+koru::sync_task<long> total(auto &ctx, auto &in)
+{
+    long sum = 0;
+    while (const auto x = co_await in.recv(ctx))
+        sum += *x;
+    co_return sum;
+}
+
+koru::sync_task<bool> send_one(auto &ctx, auto &out)
+{
+    co_return co_await out.send(ctx, 0);
+}
+
+TEST_CASE("channels pass values between pipeline stages")
+{
+    koru::context ctx;
+    koru::channel<int, 4> numbers;
+    koru::channel<int, 1> doubled;
+    auto sum = total(ctx, doubled);
+    auto mid = twice(ctx, numbers, doubled);
+    auto src = produce(ctx, numbers);
+    ctx.run();
+    REQUIRE_EQ(sum.get(), long{nvalues} * (nvalues - 1));
+
+    // Sending onto a closed channel fails
+    REQUIRE(!send_one(ctx, numbers).get());
+}
+
+TEST_CASE("atomic channels pass values between shards")
+{
+    constexpr std::array<unsigned, 2> cpus{0, 0};
+    koru::runtime rt{cpus};
+    koru::channel<int, 4, true> numbers;
+    std::binary_semaphore s{0};
+    long sum = 0;
+    rt.shard(0).spawn([&] { return produce(rt.shard(0).ctx(), numbers); });
+    rt.shard(1).spawn([&]() -> koru::sync_task<void> {
+        sum = co_await total(rt.shard(1).ctx(), numbers);
+        s.release();
+    });
+    s.acquire();
+    REQUIRE_EQ(sum, long{nvalues} * (nvalues - 1) / 2);
+}
+
+koru::sync_task<void> throttled(auto &ctx, auto &sem, int &active,
+                                int &max_active)
+{
+    co_await sem.acquire(ctx);
+    max_active = std::max(max_active, ++active);
+    co_await ctx.schedule();
+    co_await ctx.schedule();
+    --active;
+    sem.release();
+}
+
+koru::sync_task<void> append_twice(auto &ctx, auto &m, std::vector<int> &v,
+                                   const int i)
+{
+    const auto g = co_await m.scoped_lock(ctx);
+    v.push_back(i);
+    co_await ctx.schedule();
+    v.push_back(i);
+}
+
+koru::sync_task<void> await_event(auto &ctx, auto &ev, int &woken)
+{
+    co_await ev.wait(ctx);
+    ++woken;
+}
+
+TEST_CASE("semaphores, mutexes and events suspend coroutines")
+{
+    koru::context ctx;
+    std::vector<std::unique_ptr<koru::sync_task<void>>> tasks;
+
+    SUBCASE("semaphores bound the number of permit holders")
+    {
+        koru::async_semaphore sem{3};
+        int active = 0, max_active = 0;
+        for (int i = 0; i < 10; ++i)
+            tasks.emplace_back(new koru::sync_task<void>(
+                throttled(ctx, sem, active, max_active)));
+        ctx.run();
+        REQUIRE_EQ(max_active, 3);
+        REQUIRE_EQ(sem.available(), 3);
+    }
+
+    SUBCASE("mutexes get locked in FIFO order")
+    {
+        koru::async_mutex m;
+        std::vector<int> v;
+        for (int i = 0; i < 10; ++i)
+            tasks.emplace_back(
+                new koru::sync_task<void>(append_twice(ctx, m, v, i)));
+        REQUIRE(!m.try_lock());
+        ctx.run();
+        REQUIRE_EQ(v.size(), 20);
+        for (std::size_t i = 0; i < v.size(); ++i)
+            REQUIRE_EQ(v[i], static_cast<int>(i / 2));
+        REQUIRE(m.try_lock());
+        m.unlock();
+    }
+
+    SUBCASE("events resume all their waiters once set")
+    {
+        koru::async_event ev;
+        int woken = 0;
+        for (int i = 0; i < 10; ++i)
+            tasks.emplace_back(
+                new koru::sync_task<void>(await_event(ctx, ev, woken)));
+        REQUIRE_EQ(ctx.run(), 0);
+        REQUIRE_EQ(woken, 0);
+        ev.set();
+        ctx.run();
+        REQUIRE_EQ(woken, 10);
+        ev.reset();
+        REQUIRE(!ev.is_set());
+    }
+}
+
+TEST_CASE("atomic mutexes exclude coroutines on other shards")
+{
+    constexpr std::array<unsigned, 2> cpus{0, 0};
+    koru::runtime rt{cpus};
+    koru::async_mutex<true> m;
+    std::counting_semaphore<> s{0};
+    std::vector<int> v;
+    for (int i = 0; i < 10; ++i) {
+        auto &sh = rt.shard(static_cast<std::size_t>(i) % 2);
+        sh.spawn([&, i, &ctx = sh.ctx()]() -> koru::sync_task<void> {
+            co_await append_twice(ctx, m, v, i);
+            s.release();
+        });
+    }
+    for (int i = 0; i < 10; ++i)
+        s.acquire();
+    REQUIRE_EQ(v.size(), 20);
+    for (std::size_t i = 0; i < v.size(); i += 2)
+        REQUIRE_EQ(v[i], v[i + 1]);
+}
+
+koru::sync_task<void> batch_item(auto &ctx, auto &g, const int i, int &active,
+                                 int &max_active, int &finished)
+{
+    max_active = std::max(max_active, ++active);
+    co_await ctx.schedule();
+    if (i == 50)
+        throw std::runtime_error{"failed item"};
+    co_await ctx.schedule();
+    --active;
+    finished += !g.cancelled();
+}
+
+koru::sync_task<int> run_batch(auto &ctx, const int n, int &max_active,
+                               int &finished)
+{
+    koru::task_group g{ctx, 4};
+    int active = 0, started = 0;
+    for (int i = 0; i < n; ++i)
+        started += co_await g.spawn([&, i] {
+            return batch_item(ctx, g, i, active, max_active, finished);
+        });
+    try {
+        co_await g.join();
+    } catch (...) {
+        REQUIRE(!g.cancelled());
+        throw;
+    }
+    co_return started;
+}
+
+TEST_CASE("task groups bound the number of running tasks")
+{
+    koru::context ctx;
+    int max_active = 0, finished = 0;
+
+    SUBCASE("all tasks finish")
+    {
+        auto t = run_batch(ctx, 40, max_active, finished);
+        ctx.run();
+        REQUIRE_EQ(t.get(), 40);
+        REQUIRE_EQ(finished, 40);
+    }
+    SUBCASE("the first failure cancels the group")
+    {
+        auto t = run_batch(ctx, 1000, max_active, finished);
+        ctx.run();
+        REQUIRE_THROWS_AS(t.get(), std::runtime_error);
+        REQUIRE_LT(finished, 50);
+    }
+    REQUIRE_EQ(max_active, 4);
+}
\ No newline at end of file
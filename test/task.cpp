@@ -43,6 +43,14 @@ koru::sync_task<int> baz(std::binary_semaphore &s)
     co_return 42;
 }
 
+koru::sync_task<int> yield_thrice(auto &ctx)
+{
+    int n = 0;
+    for (; n < 3; ++n)
+        co_await ctx.schedule();
+    co_return n;
+}
+
 TEST_CASE("task awaiting works")
 {
     SUBCASE("task::get() works") { REQUIRE_EQ(foo().get(), 42); }
@@ -54,4 +62,104 @@ TEST_CASE("task awaiting works")
         s.acquire();
         REQUIRE_EQ(coro.get(), 42);
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("scheduling onto a context works")
+{
+    auto test = [](auto ctx) {
+        auto t1 = yield_thrice(ctx);
+        auto t2 = yield_thrice(ctx);
+        REQUIRE(!t1.await_ready());
+        REQUIRE_EQ(ctx.run(), 6);
+        REQUIRE_EQ(t1.get(), 3);
+        REQUIRE_EQ(t2.get(), 3);
+    };
+    test(koru::context<false, false>{});
+    test(koru::context<true, false>{});
+    test(koru::context<true, true>{});
+}
+
+// Yields 0, 1, ... n - 1, hopping back onto the context before each value
+koru::async_generator<int> count_to(auto &ctx, const int n, int &live)
+{
+    ++live;
+    KORU_defer[&live] { --live; };
+    for (int i = 0; i < n; ++i) {
+        co_await ctx.schedule();
+        co_yield i;
+    }
+    if (n < 0)
+        throw std::runtime_error{"negative"};
+}
+
+koru::sync_task<int> sum(koru::async_generator<int> gen, const int max)
+{
+    int s = 0;
+    for (int n = 0; n < max; ++n) {
+        const auto i = co_await gen.next();
+        if (!i)
+            break;
+        s += *i;
+    }
+    co_return s;
+}
+
+TEST_CASE("generators yield values lazily")
+{
+    koru::context ctx;
+    int live = 0;
+
+    SUBCASE("until they return")
+    {
+        auto gen = count_to(ctx, 10, live);
+        REQUIRE_EQ(live, 0);
+        auto t = sum(std::move(gen), 100);
+        REQUIRE_EQ(live, 1);
+        ctx.run();
+        REQUIRE_EQ(t.get(), 45);
+    }
+    SUBCASE("until they are abandoned")
+    {
+        auto t = sum(count_to(ctx, 10, live), 3);
+        ctx.run();
+        REQUIRE_EQ(t.get(), 0 + 1 + 2);
+    }
+    SUBCASE("until they throw")
+    {
+        auto t = sum(count_to(ctx, -1, live), 100);
+        ctx.run();
+        REQUIRE_THROWS_AS(t.get(), std::runtime_error);
+    }
+    REQUIRE_EQ(live, 0);
+}
+
+koru::sync_task<std::thread::id> offloaded_thread_id(auto &ctx)
+{
+    co_return co_await ctx.offload([] { return std::this_thread::get_id(); });
+}
+
+koru::sync_task<void> offload_throw(auto &ctx)
+{
+    co_await ctx.offload([] { throw std::runtime_error{"offloaded"}; });
+}
+
+TEST_CASE("offloading blocking work works")
+{
+    auto test = [](auto ctx, bool inline_) {
+        if (inline_)
+            ctx.set_offload_limits({.threads = 0});
+        auto t1 = offloaded_thread_id(ctx);
+        auto t2 = offload_throw(ctx);
+        ctx.run();
+        REQUIRE_EQ(t1.get() == std::this_thread::get_id(), inline_);
+        REQUIRE_THROWS_AS(t2.get(), std::runtime_error);
+        const auto stats = ctx.offload_stats();
+        REQUIRE_EQ(stats.inlined, inline_ ? 2 : 0);
+        REQUIRE_EQ(stats.completed, inline_ ? 0 : 2);
+    };
+    for (bool inline_ : {false, true}) {
+        test(koru::context<false, false>{}, inline_);
+        test(koru::context<true, false>{}, inline_);
+        test(koru::context<true, true>{}, inline_);
+    }
+}